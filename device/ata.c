@@ -0,0 +1,117 @@
+#include "ata.h"
+#include "debug.h"
+#include "global.h"
+#include "io.h"
+#include "print.h"
+#include "sync.h"
+
+/* 主通道的命令块寄存器，与 mbr、loader 读取内核时使用的端口相同 */
+#define ATA_DATA     0x1f0
+#define ATA_SEC_CNT  0x1f2
+#define ATA_LBA_LOW  0x1f3
+#define ATA_LBA_MID  0x1f4
+#define ATA_LBA_HIGH 0x1f5
+#define ATA_DEVICE   0x1f6
+#define ATA_STATUS   0x1f7
+#define ATA_CMD      0x1f7
+/* 主通道的控制块寄存器 */
+#define ATA_CTRL     0x3f6
+
+/* device 寄存器：LBA 模式、主盘，低4位为 LBA 的第 24~27 位 */
+#define ATA_DEV_LBA_MASTER 0xe0
+
+/* status 寄存器的位 */
+#define ATA_STAT_BSY 0x80
+#define ATA_STAT_DRQ 0x08
+#define ATA_STAT_ERR 0x01
+
+/* 命令 */
+#define ATA_CMD_READ  0x20
+#define ATA_CMD_WRITE 0x30
+#define ATA_CMD_FLUSH 0xe7
+
+/* 一条命令最多读写 256 个扇区，sector count 寄存器写 0 表示 256 */
+#define ATA_MAX_SECTORS 256
+
+/* 主通道同一时刻只能执行一条命令 */
+static struct lock ata_lock;
+
+/* ata_wait - 忙等硬盘不再忙碌，返回此时的状态 */
+static uint8_t ata_wait(void) {
+    uint8_t status;
+    while ((status = inb(ATA_STATUS)) & ATA_STAT_BSY)
+        ;
+    return status;
+}
+
+/* ata_wait_drq - 忙等硬盘准备好传输一个扇区的数据 */
+static void ata_wait_drq(void) {
+    uint8_t status = ata_wait();
+    while (!(status & (ATA_STAT_DRQ | ATA_STAT_ERR)))
+        status = inb(ATA_STATUS);
+    if (status & ATA_STAT_ERR)
+        PANIC("ata: device error");
+}
+
+/* ata_cmd_out - 设置起始扇区和扇区数后发出命令 */
+static void ata_cmd_out(uint32_t lba, uint32_t sec_cnt, uint8_t cmd) {
+    ASSERT(lba < (1 << 28) && sec_cnt > 0 && sec_cnt <= ATA_MAX_SECTORS);
+    ata_wait();
+    outb(ATA_SEC_CNT, (uint8_t)sec_cnt);
+    outb(ATA_LBA_LOW, lba);
+    outb(ATA_LBA_MID, lba >> 8);
+    outb(ATA_LBA_HIGH, lba >> 16);
+    outb(ATA_DEVICE, ATA_DEV_LBA_MASTER | ((lba >> 24) & 0x0f));
+    outb(ATA_CMD, cmd);
+}
+
+/**
+ * ata_init - 初始化主通道主盘的 PIO 访问
+ *
+ * 8259A 没有打开 IRQ14，读写都以轮询状态寄存器的方式完成，这里同时在设备上关闭中断（nIEN）。
+ */
+void ata_init(void) {
+    put_str("  ata_init start\n");
+    lock_init(&ata_lock);
+    outb(ATA_CTRL, 0x02);
+    put_str("  ata_init done\n");
+}
+
+/**
+ * ata_read - 从主盘读取扇区
+ * @lba: 起始扇区号
+ * @buf: 缓冲区
+ * @sec_cnt: 扇区数，不超过 256
+ */
+void ata_read(uint32_t lba, void *buf, uint32_t sec_cnt) {
+    lock_acquire(&ata_lock);
+    ata_cmd_out(lba, sec_cnt, ATA_CMD_READ);
+    uint32_t i;
+    for (i = 0; i < sec_cnt; i++) {
+        ata_wait_drq();
+        insw(ATA_DATA, (uint8_t *)buf + i * SECTOR_SIZE, SECTOR_SIZE / 2);
+    }
+    lock_release(&ata_lock);
+}
+
+/**
+ * ata_write - 向主盘写入扇区
+ * @lba: 起始扇区号
+ * @buf: 要写入的数据
+ * @sec_cnt: 扇区数，不超过 256
+ *
+ * 写完后刷新硬盘的写缓存，返回时数据已经落盘。
+ */
+void ata_write(uint32_t lba, const void *buf, uint32_t sec_cnt) {
+    lock_acquire(&ata_lock);
+    ata_cmd_out(lba, sec_cnt, ATA_CMD_WRITE);
+    uint32_t i;
+    for (i = 0; i < sec_cnt; i++) {
+        ata_wait_drq();
+        outsw(ATA_DATA, (const uint8_t *)buf + i * SECTOR_SIZE, SECTOR_SIZE / 2);
+    }
+    ata_wait();
+    outb(ATA_CMD, ATA_CMD_FLUSH);
+    ata_wait();
+    lock_release(&ata_lock);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef __DEVICE_ATA_H
+#define __DEVICE_ATA_H
+#include "stdint.h"
+
+/* 扇区大小 */
+#define SECTOR_SIZE 512
+
+void ata_init(void);
+void ata_read(uint32_t lba, void *buf, uint32_t sec_cnt);
+void ata_write(uint32_t lba, const void *buf, uint32_t sec_cnt);
+#endif
\ No newline at end of file
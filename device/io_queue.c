@@ -74,13 +74,13 @@ static void ioq_wait(struct task_struct **waiter) {
  *
  * 此函数解除之前由ioq_wait()阻塞的线程。它接受等待者的task_struct指针，并将其解除阻塞，
  * 然后将指针设置为NULL。这是生产者-消费者问题中同步的一部分，当被阻塞的线程（等待者）等待的条件变为真时，
- * 需要唤醒它。
+ * 需要唤醒它。等待者被视为 I/O 密集型任务，唤醒时提升其在就绪队列中的级别。
  *
  * 上下文: 与ioq_wait()一起使用，用于管理在生产者-消费者等同步场景中线程的阻塞和解除阻塞。
  */
 static void ioq_wakeup(struct task_struct **waiter) {
     ASSERT(*waiter != NULL);
-    thread_unblock(*waiter);
+    thread_unblock_io(*waiter);
     *waiter = NULL;
 }
 
@@ -5,19 +5,31 @@
 #include "thread.h"
 #include "interrupt.h"
 #include "stdint.h"
+#include "task_group.h"
+#include "list.h"
 
-#define IRQ0_FREQUENCY    100
 #define INPUT_FREQUENCY   1193180
-#define COUNTER0_VALUE    INPUT_FREQUENCY / IRQ0_FREQUENCY
+#define COUNTER0_VALUE    (INPUT_FREQUENCY / IRQ0_FREQUENCY)
 #define COUNTER0_PORT     0x40
 #define COUNTER0_NO       0
 #define COUNTER0_MODE     2
+#define COUNTER0_ONESHOT_MODE 0
 #define READ_WRITE_LATCH  3
+#define COUNTER_LATCH     0
 #define PIT_CONTROL_PORT  0x43
 
+/* 单次模式最多能定时的嘀嗒数，受 16 位计数器限制 */
+#define ONESHOT_MAX_TICKS (0xffff / COUNTER0_VALUE)
+
 /* 内核自中断开启以内总的嘀嗒数  */
 uint32_t ticks;
 
+/* 睡眠的线程，按唤醒的嘀嗒从早到晚排列 */
+static struct list sleep_list;
+
+/* 空闲时计数器 0 处于单次模式，此为到期时经过的嘀嗒数；为 0 表示处于周期模式 */
+static uint32_t oneshot_ticks;
+
 /**
  * frequency_set - 初始化可编程间隔定时器 Intel 8253
  * @counter_port: 对于计数器编号 0，此值为 0x40
@@ -38,25 +50,130 @@ static void frequency_set(  uint8_t counter_port,
     /* 计数器0初始计数值的低8位 */
     outb(counter_port, (uint8_t)counter_value);
     /* 计数器0初始计数值的高8位 */
-    outb(counter_port, (uint8_t)counter_value >> 8);
+    outb(counter_port, (uint8_t)(counter_value >> 8));
+}
+
+/* counter0_read - 锁存并读出计数器 0 的当前计数值 */
+static uint16_t counter0_read(void) {
+    outb(PIT_CONTROL_PORT, (uint8_t)(COUNTER0_NO << 6 | COUNTER_LATCH << 4));
+    uint8_t low = inb(COUNTER0_PORT);
+    uint8_t high = inb(COUNTER0_PORT);
+    return (uint16_t)high << 8 | low;
+}
+
+/* periodic_set - 计数器 0 回到每个嘀嗒中断一次的周期模式 */
+static void periodic_set(void) {
+    oneshot_ticks = 0;
+    frequency_set(COUNTER0_PORT, COUNTER0_NO, READ_WRITE_LATCH, COUNTER0_MODE, COUNTER0_VALUE);
+}
+
+/* sleepers_wakeup - 唤醒睡眠时间已到的线程 */
+static void sleepers_wakeup(void) {
+    while (!list_empty(&sleep_list)) {
+        struct task_struct *pthread = elem2entry(struct task_struct, general_tag, sleep_list.head.next);
+        if ((int32_t)(ticks - pthread->sleep_until) < 0)
+            break;
+        list_pop(&sleep_list);
+        thread_unblock(pthread);
+    }
 }
 
 /*
  * intr_time_handler - 时钟的中断处理函数
+ *
+ * 单次模式到期时一次补上空闲期间经过的嘀嗒，并回到周期模式。空闲任务不计入调度类和任务组，
+ * 中断返回后它会从 hlt 醒来并重新调度。
  */
 static void intr_time_handler(void) {
     struct task_struct *cur_thread = running_thread();
-    ASSERT(cur_thread->stack_magic == 0x20030807);
+    ASSERT(cur_thread->stack_magic == STACK_MAGIC);
 
-    cur_thread->elapsed_ticks++;
-    ticks++;
+    uint32_t elapsed = 1;
+    if (oneshot_ticks != 0) {
+        elapsed = oneshot_ticks;
+        periodic_set();
+    }
+    cur_thread->elapsed_ticks += elapsed;
+    ticks += elapsed;
+    sleepers_wakeup();
 
-    if (cur_thread->ticks == 0) {
-        /* time slice of current thread is over */
+    /* the task group may run out of its quota, the scheduling class decides whether the time slice is over */
+    bool throttled = task_group_tick(cur_thread);
+    if (cur_thread == idle_thread)
+        return;
+    bool slice_over = cur_thread->sched_class->tick(cur_thread);
+    if (throttled || slice_over || need_resched)
         schedule();
-    } else {
-        cur_thread->ticks--;
+}
+
+/**
+ * mtime_sleep - 让当前线程睡眠至少 m_seconds 毫秒
+ * @m_seconds: 睡眠的毫秒数，向上取整到嘀嗒
+ *
+ * 线程阻塞在 sleep_list 上，由时钟中断在到期时唤醒，睡眠期间不占用 CPU。
+ */
+void mtime_sleep(uint32_t m_seconds) {
+    uint32_t sleep_ticks = DIV_ROUND_UP(m_seconds, MS_PER_TICK);
+    if (sleep_ticks == 0)
+        return;
+    struct task_struct *cur_thread = running_thread();
+    enum intr_status old_status = intr_disable();
+    cur_thread->sleep_until = ticks + sleep_ticks;
+    struct list_elem *elem = sleep_list.head.next;
+    while (elem != &sleep_list.tail) {
+        struct task_struct *pthread = elem2entry(struct task_struct, general_tag, elem);
+        if ((int32_t)(pthread->sleep_until - cur_thread->sleep_until) > 0)
+            break;
+        elem = elem->next;
     }
+    list_insert_before(elem, &cur_thread->general_tag);
+    thread_block(TASK_BLOCKED);
+    intr_set_status(old_status);
+}
+
+/**
+ * timer_idle_enter - 空闲任务 hlt 之前，把计数器 0 改为单次模式
+ *
+ * 定时到下一个真正的期限：最早的睡眠线程到期，或被节流的任务组开始新的周期，最长 ONESHOT_MAX_TICKS
+ * 个嘀嗒。期间没有周期性的时钟中断，宿主机上的空闲虚拟机不再被每秒 100 次唤醒。
+ * 期限就在下一个嘀嗒时保持周期模式。必须关中断调用。
+ */
+void timer_idle_enter(void) {
+    ASSERT(intr_get_status() == INTR_OFF);
+    uint32_t next = ONESHOT_MAX_TICKS;
+    if (!list_empty(&sleep_list)) {
+        struct task_struct *pthread = elem2entry(struct task_struct, general_tag, sleep_list.head.next);
+        int32_t left = (int32_t)(pthread->sleep_until - ticks);
+        if (left < (int32_t)next)
+            next = left < 0 ? 0 : left;
+    }
+    uint32_t group_next = task_group_next_period();
+    if (group_next < next)
+        next = group_next;
+    if (next <= 1)
+        return;
+
+    oneshot_ticks = next;
+    frequency_set(COUNTER0_PORT, COUNTER0_NO, READ_WRITE_LATCH, COUNTER0_ONESHOT_MODE,
+                  (uint16_t)(next * COUNTER0_VALUE));
+}
+
+/**
+ * timer_idle_exit - 空闲任务被切换走时，提前结束单次模式
+ *
+ * 由其他中断唤醒了任务时单次定时还没有到期，按计数器的剩余值补上已经经过的整嘀嗒，
+ * 不足一个嘀嗒的部分舍去，然后回到周期模式。计数器已过零而中断尚未响应时按到期处理，
+ * 之后响应的那次中断按一个普通嘀嗒计入。已处于周期模式时什么也不做。必须关中断调用。
+ */
+void timer_idle_exit(void) {
+    ASSERT(intr_get_status() == INTR_OFF);
+    if (oneshot_ticks == 0)
+        return;
+    uint32_t total = oneshot_ticks * COUNTER0_VALUE;
+    uint32_t left = counter0_read();
+    uint32_t elapsed = left <= total ? (total - left) / COUNTER0_VALUE : oneshot_ticks;
+    periodic_set();
+    ticks += elapsed;
 }
 
 /*
@@ -67,7 +184,8 @@ static void intr_time_handler(void) {
  */
 void timer_init() {
     put_str("  timer_init start\n");
-    frequency_set(COUNTER0_PORT, COUNTER0_NO, READ_WRITE_LATCH, COUNTER0_MODE,COUNTER0_VALUE);
+    list_init(&sleep_list);
+    periodic_set();
     register_handler(0x20, intr_time_handler);
     put_str("  timer_init done\n");
 }
\ No newline at end of file
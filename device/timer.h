@@ -1,4 +1,16 @@
 #ifndef __DEVICE_TIME_H
 #define __DEVICE_TIME_H
+#include "stdint.h"
+
+/* 时钟中断的频率，以及每个嘀嗒的毫秒数 */
+#define IRQ0_FREQUENCY 100
+#define MS_PER_TICK (1000 / IRQ0_FREQUENCY)
+
+/* 时钟中断发生以来的嘀嗒数 */
+extern uint32_t ticks;
+
 void timer_init();
+void mtime_sleep(uint32_t m_seconds);
+void timer_idle_enter(void);
+void timer_idle_exit(void);
 #endif
\ No newline at end of file
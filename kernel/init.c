@@ -4,20 +4,29 @@
 #include "memory.h"
 #include "interrupt.h"
 #include "thread.h"
+#include "task_group.h"
 #include "console.h"
 #include "keyboard.h"
 #include "tss.h"
 #include "syscall_init.h"
+#include "shm.h"
+#include "ata.h"
+#include "swap.h"
 
 void init_all() {
     put_str("init_all_start\n");
     idt_init();
     mem_init();
     thread_init();
+    task_group_init();
+    zero_thread_init();
     timer_init();
     console_init();
     keyboard_init();
+    ata_init();
+    swap_init();
     tss_init();
     syscall_init();
+    shm_init();
     //put_str("init_all_end\n");
 }
\ No newline at end of file
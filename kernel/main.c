@@ -6,9 +6,11 @@
 #include "print.h"
 #include "string.h"
 #include "thread.h"
+#include "timer.h"
 #include "console.h"
 #include "process.h"
 #include "stdio.h"
+#include "mem_profile.h"
 
 #include "syscall_init.h"
 #include "syscall.h"
@@ -31,7 +33,12 @@ int main() {
     console_put_char('\n');
     thread_start("kthread_a",31,kthread_a," A_");
     thread_start("kthread_b",8,kthread_b," B_");
-    while (1);
+#ifdef CONFIG_MEM_PROFILE
+    mem_profile_dump();
+#endif
+    /* 主线程没有别的事可做，阻塞后不再被调度，CPU 空闲时由空闲任务执行 hlt */
+    while (1)
+        thread_block(TASK_BLOCKED);
     // while (1){
     //     console_put_str("Main ");
     // }
@@ -43,7 +50,8 @@ void kthread_a(void *arg) {
     console_put_str("I am thread_a_pid:0x ");
     console_put_int(sys_getpid());
     console_put_char('\n');
-    while (1);
+    while (1)
+        mtime_sleep(1000);
 }
 
 void kthread_b(void *arg) {
@@ -51,17 +59,20 @@ void kthread_b(void *arg) {
     console_put_str("I am thread_b_pid:0x ");
     console_put_int(sys_getpid());
     console_put_char('\n');
-    while (1);
+    while (1)
+        mtime_sleep(1000);
 }
 
 void u_prog_a(void){
     char* name = "prog_a";
     printf("I am %s, my pid:%d%c",name,getpid(),'\n');
-    while(1);
+    while (1)
+        msleep(1000);
 }
 
 void u_prog_b(void){
     char* name = "prog_b";
     printf("I am %s, my pid:%d%c",name,getpid(),'\n');
-    while(1);
+    while (1)
+        msleep(1000);
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "mem_profile.h"
+
+#ifdef CONFIG_MEM_PROFILE
+#include "console.h"
+#include "global.h"
+#include "interrupt.h"
+#include "timer.h"
+
+#define PAGE_SIZE 4096
+
+/* 空槽位和已删除槽位的键，页对齐的虚拟地址与带标记的页表物理地址都不会取到这两个值 */
+#define SLOT_EMPTY 0
+#define SLOT_DELETED 0xffffffff
+
+/**
+ * struct alloc_record - 一次尚未释放的内核页面分配
+ * @key: 分配的起始虚拟地址；页表页面没有虚拟地址，用物理地址加1作为键
+ * @caller: 分配函数的返回地址，即发起分配的调用点
+ * @pg_cnt: 页面数量
+ * @tick: 分配时的时钟嘀嗒数
+ */
+struct alloc_record {
+    uint32_t key;
+    uint32_t caller;
+    uint32_t pg_cnt;
+    uint32_t tick;
+};
+
+/**
+ * struct alloc_site - 汇总后的一个分配点
+ * @caller: 调用点地址
+ * @pages: 该调用点仍持有的页面数
+ * @allocs: 该调用点仍未释放的分配次数
+ * @last_tick: 最近一次分配的时钟嘀嗒数
+ */
+struct alloc_site {
+    uint32_t caller;
+    uint32_t pages;
+    uint32_t allocs;
+    uint32_t last_tick;
+};
+
+/* 开放定址、线性探测的哈希表，槽位全部用完后新的分配只计入 dropped */
+static struct alloc_record records[MEM_PROFILE_SLOTS];
+static uint32_t dropped;
+
+/* slot_hash - 键的低12位在页对齐时恒为0或1，先去掉再做乘法散列 */
+static uint32_t slot_hash(uint32_t key) {
+    return ((key >> 12) * 2654435761u) & (MEM_PROFILE_SLOTS - 1);
+}
+
+/* record_find - 查找键为 key 的记录，不存在时返回 NULL */
+static struct alloc_record *record_find(uint32_t key) {
+    uint32_t idx = slot_hash(key), probe;
+    for (probe = 0; probe < MEM_PROFILE_SLOTS; probe++) {
+        struct alloc_record *rec = &records[(idx + probe) & (MEM_PROFILE_SLOTS - 1)];
+        if (rec->key == key)
+            return rec;
+        if (rec->key == SLOT_EMPTY)
+            return NULL;
+    }
+    return NULL;
+}
+
+/**
+ * mem_profile_alloc - 记录一次内核页面分配
+ * @key: 起始虚拟地址，页表页面为物理地址加1
+ * @caller: 调用点地址
+ * @pg_cnt: 页面数量
+ */
+void mem_profile_alloc(uint32_t key, uint32_t caller, uint32_t pg_cnt) {
+    enum intr_status old_status = intr_disable();
+    uint32_t idx = slot_hash(key), probe;
+    for (probe = 0; probe < MEM_PROFILE_SLOTS; probe++) {
+        struct alloc_record *rec = &records[(idx + probe) & (MEM_PROFILE_SLOTS - 1)];
+        if (rec->key == SLOT_EMPTY || rec->key == SLOT_DELETED) {
+            rec->key = key;
+            rec->caller = caller;
+            rec->pg_cnt = pg_cnt;
+            rec->tick = ticks;
+            break;
+        }
+    }
+    if (probe == MEM_PROFILE_SLOTS)
+        dropped++;
+    intr_set_status(old_status);
+}
+
+/**
+ * mem_profile_free - 从起始处释放一次分配中的 pg_cnt 个页面
+ * @key: 释放的起始虚拟地址，页表页面为物理地址加1
+ * @pg_cnt: 页面数量
+ *
+ * 只释放前一部分时记录改以剩余部分的起始地址为键。不是从某次分配的起始处开始的释放无法对应，直接忽略。
+ */
+void mem_profile_free(uint32_t key, uint32_t pg_cnt) {
+    enum intr_status old_status = intr_disable();
+    struct alloc_record *rec = record_find(key);
+    if (rec != NULL) {
+        struct alloc_record rest = *rec;
+        rec->key = SLOT_DELETED;
+        if (rest.pg_cnt > pg_cnt) {
+            intr_set_status(old_status);
+            mem_profile_alloc(rest.key + pg_cnt * PAGE_SIZE, rest.caller, rest.pg_cnt - pg_cnt);
+            return;
+        }
+    }
+    intr_set_status(old_status);
+}
+
+/**
+ * mem_profile_dump - 按持有页面数列出前 MEM_PROFILE_TOP 个分配点
+ *
+ * 每行依次为调用点地址、持有页面数、未释放的分配次数、最近一次分配的时钟嘀嗒数，均为十六进制。
+ * 内核无法读取 build/kernel.map，保存这段输出后用 make memprof_sym 把调用点翻译成函数名。
+ */
+void mem_profile_dump(void) {
+    struct alloc_site sites[MEM_PROFILE_SITES];
+    uint32_t site_cnt = 0, other_pages = 0, i, j;
+
+    enum intr_status old_status = intr_disable();
+    for (i = 0; i < MEM_PROFILE_SLOTS; i++) {
+        struct alloc_record *rec = &records[i];
+        if (rec->key == SLOT_EMPTY || rec->key == SLOT_DELETED)
+            continue;
+        for (j = 0; j < site_cnt && sites[j].caller != rec->caller; j++)
+            ;
+        if (j == site_cnt) {
+            if (site_cnt == MEM_PROFILE_SITES) {
+                other_pages += rec->pg_cnt;
+                continue;
+            }
+            sites[site_cnt].caller = rec->caller;
+            sites[site_cnt].pages = 0;
+            sites[site_cnt].allocs = 0;
+            sites[site_cnt].last_tick = 0;
+            site_cnt++;
+        }
+        sites[j].pages += rec->pg_cnt;
+        sites[j].allocs++;
+        if (rec->tick > sites[j].last_tick)
+            sites[j].last_tick = rec->tick;
+    }
+    intr_set_status(old_status);
+
+    /* 只需要前 MEM_PROFILE_TOP 个，选择排序即可 */
+    for (i = 0; i < site_cnt && i < MEM_PROFILE_TOP; i++) {
+        uint32_t max = i;
+        for (j = i + 1; j < site_cnt; j++) {
+            if (sites[j].pages > sites[max].pages)
+                max = j;
+        }
+        struct alloc_site tmp = sites[i];
+        sites[i] = sites[max];
+        sites[max] = tmp;
+    }
+
+    console_put_str("memprof begin\n");
+    for (i = 0; i < site_cnt && i < MEM_PROFILE_TOP; i++) {
+        console_put_str("memprof ");
+        console_put_int(sites[i].caller);
+        console_put_char(' ');
+        console_put_int(sites[i].pages);
+        console_put_char(' ');
+        console_put_int(sites[i].allocs);
+        console_put_char(' ');
+        console_put_int(sites[i].last_tick);
+        console_put_char('\n');
+    }
+    console_put_str("memprof other_pages ");
+    console_put_int(other_pages);
+    console_put_str(" dropped ");
+    console_put_int(dropped);
+    console_put_str("\nmemprof end\n");
+}
+#endif
\ No newline at end of file
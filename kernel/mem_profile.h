@@ -0,0 +1,30 @@
+#ifndef __KERNEL_MEM_PROFILE_H
+#define __KERNEL_MEM_PROFILE_H
+#include "stdint.h"
+
+/* 记录存活分配的哈希表槽位数，须为2的幂 */
+#define MEM_PROFILE_SLOTS 256
+/* 汇总时最多区分的分配点个数 */
+#define MEM_PROFILE_SITES 32
+/* mem_profile_dump 列出的分配点个数 */
+#define MEM_PROFILE_TOP 8
+
+/*
+ * 编译时定义 CONFIG_MEM_PROFILE（make MEM_PROFILE=1）才会记录内核页面的分配点，
+ * 否则下面的宏不产生任何代码。
+ */
+#ifdef CONFIG_MEM_PROFILE
+void mem_profile_alloc(uint32_t key, uint32_t caller, uint32_t pg_cnt);
+void mem_profile_free(uint32_t key, uint32_t pg_cnt);
+void mem_profile_dump(void);
+
+/* 在分配函数中使用，记录的调用点是该分配函数的返回地址 */
+#define MEM_PROFILE_ALLOC(key, pg_cnt) \
+    mem_profile_alloc((uint32_t)(key), (uint32_t)__builtin_return_address(0), (pg_cnt))
+#define MEM_PROFILE_FREE(key, pg_cnt) mem_profile_free((uint32_t)(key), (pg_cnt))
+#else
+#define MEM_PROFILE_ALLOC(key, pg_cnt) ((void)0)
+#define MEM_PROFILE_FREE(key, pg_cnt) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
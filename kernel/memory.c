@@ -10,47 +10,348 @@
 #include "string.h"
 #include "thread.h"
 #include "sync.h"
+#include "userprog.h"
+#include "vma.h"
+#include "syscall.h"
+#include "mem_profile.h"
+#include "swap.h"
+#include "zram.h"
 #define PAGE_SIZE 4096
 
-/* 内核位图的虚拟地址 */
+/* 一次操作中待失效的页面超过此数量时，不再逐页 invlpg，而是刷新整个 TLB */
+#define TLB_FLUSH_THRESHOLD 32
+
+/* 每个内存池预先清零页框储备的容量，储备低于 ZERO_RESERVE_LOW 时唤醒清零线程 */
+#define ZERO_RESERVE_MAX 64
+#define ZERO_RESERVE_LOW 16
+
+/* 内核虚拟地址位图的虚拟地址，内存池位图与页框描述符一起从内核内存池中划出 */
 #define MEM_BITMAP_BASE 0xc009a000
 
-/* 内核的虚拟地址从3G开始，并且需要跨越起始和使用的1MB，即0xc0000000 + 0x00100000 = 0xc0100000 */
-#define KERNEL_HEAP_START 0xc0100000
+/* 加载器保存的 E820 内存布局：ARDS 数组（最多 12 项）及其数量，经由低端 4MB 大页访问 */
+#define ARDS_BUF_ADDR 0xc0000b0a
+#define ARDS_NR_ADDR  0xc0000bfe
+#define ARDS_TYPE_USABLE 1
+
+/* 可用物理内存区间的最大数量 */
+#define MEM_REGION_MAX 16
+
+/* 低 2MB 物理内存由内核映像、加载器和页目录、页表占用 */
+#define LOW_MEM_RESERVED 0x200000
+
+/* CR4 的 PGE 位，置1时 PTE 中的 G 位才生效 */
+#define CR4_PGE 0x80
+
+/* 临时映射窗口的槽位数，每个槽位是一个内核虚拟页面 */
+#define KMAP_SLOTS 16
+
+/* 内核物理内存池的页框数上限（256MB），其余可用内存都交给用户内存池 */
+#define KERNEL_POOL_MAX_PAGES (64 * 1024)
+
+/* 内核的虚拟地址从3G开始，0xc0000000～0xc03fffff 由一个4MB大页直接映射低端物理内存，因此堆从 0xc0400000 开始 */
+#define KERNEL_HEAP_START 0xc0400000
+
+/* 内核页目录的虚拟地址，物理地址 0x100000 位于低端 4MB 大页之内 */
+#define KERNEL_PAGE_DIR 0xc0100000
+
+/* 加载器为 PDE 769～1022 预先建立了页表（物理地址 0x102000 起），内核堆不能超出它们覆盖的范围 */
+#define KERNEL_PDE_FIRST 769
+#define KERNEL_PDE_LAST  1022
+#define KERNEL_HEAP_PAGES ((KERNEL_PDE_LAST - KERNEL_PDE_FIRST + 1) * 1024)
+
+/* PDE 中软件可用的第 9 位，map_range 执行期间标记本次新分配的页表，以便失败时撤销 */
+#define PDE_FRESH 0x200
+
+/* map_new_pages 每批分配并映射的页面数 */
+#define MAP_BATCH 32
+
+/* 一个 4MB 大页包含的 4KB 页面数 */
+#define LARGE_PAGE_CNT 1024
 
 #define PDE_IDX(addr) ((addr & 0xffc00000) >> 22)
 #define PTE_IDX(addr) ((addr & 0x003ff000) >> 12)
 
+/* 伙伴系统的最大阶数，最大的块为 2^10 个页框，即 4MB */
+#define BUDDY_MAX_ORDER 10
+
+/* 页框描述符的标志位 */
+#define FRAME_FREE_HEAD 1 //该页框是某个空闲块的首页框
+
+/**
+ * struct page_frame - 物理页框描述符，内存池中每个页框对应一个。
+ * @free_tag: 页框作为空闲块首页框时，在对应阶数 free_area 链表中的节点。
+ * @order: 页框作为空闲块首页框时，该空闲块的阶数。
+ * @flags: 页框标志，FRAME_FREE_HEAD 表示是空闲块首页框。
+ * @ref_cnt: 已分配页框除第一个持有者之外的引用数，为0时 pfree 才真正归还页框。
+ */
+struct page_frame {
+    struct list_elem free_tag;
+    uint8_t order;
+    uint8_t flags;
+    uint16_t ref_cnt;
+};
+
 /**
  * struct pool - 表示一个物理内存池。
  * @pool_bitmap: 用于跟踪内存池中页面分配状态的位图。
  * @phy_addr_start: 内存池的起始物理地址。
  * @pool_size: 内存池的总大小。
  * @_lock: 用于申请内存时的互斥。
+ * @frames: 页框描述符数组，第 i 项对应 phy_addr_start + i * PAGE_SIZE 处的页框。
+ * @free_area: 伙伴系统各阶的空闲块链表，第 k 项链接所有大小为 2^k 页框的空闲块。
+ * @free_pages: 内存池中空闲页框的数量。
+ * @total_pages: 伙伴系统初始化时交给内存池管理的页框数，不含空洞和元数据。
+ * @used_pages: 已交给调用者的页框数，页框弹匣和已清零页框储备中的页框仍算作空闲。
  * 此结构用于管理物理内存池，无论是用于内核还是用户空间。
- * 它包括一个位图，用于高效地跟踪哪些页面是空闲的或已分配的，以及内存池的起始地址和总大小。
+ * 页框由伙伴系统分配与回收，位图与伙伴系统同步更新，记录每个页框是否已分配。
  */
 struct pool {
     struct bitmap pool_bitmap;
     uint32_t phy_addr_start;
     uint32_t pool_size;
     struct lock _lock;
+    struct page_frame *frames;
+    struct list free_area[BUDDY_MAX_ORDER + 1];
+    uint32_t free_pages;
+    uint32_t total_pages;
+    uint32_t used_pages;
+};
+/**
+ * struct tlb_batch - 一次页面回收操作中收集的待失效虚拟地址。
+ * @cnt: 已收集的页面数，可能超过 TLB_FLUSH_THRESHOLD。
+ * @vaddrs: 前 TLB_FLUSH_THRESHOLD 个页面的虚拟地址。
+ * @global: 是否包含内核空间的全局页。
+ */
+struct tlb_batch {
+    uint32_t cnt;
+    uint32_t vaddrs[TLB_FLUSH_THRESHOLD];
+    bool global;
+};
+
+/**
+ * struct zero_reserve - 已清零的空闲页框储备。
+ * @cnt: 储备中的页框数量。
+ * @frames: 储备页框的物理地址。
+ * @hits: 需要清零页面的分配直接从储备中取得页框的次数。
+ * @misses: 储备为空、只能同步清零的次数。
+ *
+ * 由清零线程在空闲时补充，存取时关中断保证原子性。
+ */
+struct zero_reserve {
+    uint32_t cnt;
+    uint32_t frames[ZERO_RESERVE_MAX];
+    uint32_t hits;
+    uint32_t misses;
+};
+
+/**
+ * struct ards - BIOS 0xe820 子功能返回的地址范围描述符（Address Range Descriptor Structure）。
+ * @base_low: 基地址的低32位。
+ * @base_high: 基地址的高32位。
+ * @length_low: 长度的低32位。
+ * @length_high: 长度的高32位。
+ * @type: 内存类型，1 为可用内存，其余（保留、ACPI 等）均不可使用。
+ */
+struct ards {
+    uint32_t base_low;
+    uint32_t base_high;
+    uint32_t length_low;
+    uint32_t length_high;
+    uint32_t type;
+};
+
+/* struct mem_region - 一段页对齐的可用物理内存 [start, end) */
+struct mem_region {
+    uint32_t start;
+    uint32_t end;
 };
+
+/* 按起始地址排序、互不相邻的可用物理内存区间 */
+static struct mem_region mem_regions[MEM_REGION_MAX];
+static uint32_t mem_region_cnt;
+
 /* 内核、用户的物理内存池 */
 struct pool kernel_pool, user_pool;
 
 /* 内核的虚拟内存池 */
 struct virtual_addr kernel_vaddr;
 
+/* 已建立的 4MB 大页映射和 4KB 页面映射的累计数量 */
+static uint32_t large_mappings, small_mappings;
+
+/* 用户空间页表占用的页框数 */
+static uint32_t pt_pages;
+
+/* 内核、用户内存池的已清零页框储备，下标与 MAG_KERNEL/MAG_USER 一致 */
+static struct zero_reserve zero_reserves[2];
+/* 清零线程及其是否因无事可做而阻塞 */
+static struct task_struct *zero_thread;
+static bool zero_thread_idle;
+/* 临时映射窗口的起始虚拟地址，以及各槽位是否被占用的位掩码 */
+static uint32_t kmap_base;
+static uint32_t kmap_used;
+
+/**
+ * struct arena - 内存仓库的元信息，位于 arena 页面的起始处。
+ * @desc: 此 arena 所属的内存块描述符，大内存分配时为 NULL。
+ * @cnt: large 为 false 时表示空闲内存块数量，为 true 时表示占用的页框数。
+ * @large: 是否为超过 1024 字节的大内存分配。
+ *
+ * 小内存分配时一个 arena 占一个页面，元信息之后的空间被切分为同规格的内存块；
+ * 大内存分配时直接分配若干页面，元信息之后的空间整体交给调用者。
+ */
+struct arena {
+    struct mem_block_desc *desc;
+    uint32_t cnt;
+    bool large;
+};
+
+/* 内核内存块描述符数组 */
+struct mem_block_desc k_block_descs[MB_DESC_CNT];
+
+
+/**
+ * mem_region_add - 加入一段可用物理内存，保持区间有序，与已有区间重叠或相接时合并。
+ * @start: 起始物理地址，页对齐。
+ * @end: 结束物理地址（不含），页对齐。
+ */
+static void mem_region_add(uint32_t start, uint32_t end) {
+    if (start >= end)
+        return;
+    uint32_t i = 0, j;
+    while (i < mem_region_cnt && mem_regions[i].end < start)
+        i++;
+
+    if (i < mem_region_cnt && mem_regions[i].start <= end) {
+        if (start < mem_regions[i].start)
+            mem_regions[i].start = start;
+        if (end > mem_regions[i].end)
+            mem_regions[i].end = end;
+        /* 扩大后可能与后面的区间相接 */
+        while (i + 1 < mem_region_cnt && mem_regions[i + 1].start <= mem_regions[i].end) {
+            if (mem_regions[i + 1].end > mem_regions[i].end)
+                mem_regions[i].end = mem_regions[i + 1].end;
+            for (j = i + 1; j + 1 < mem_region_cnt; j++)
+                mem_regions[j] = mem_regions[j + 1];
+            mem_region_cnt--;
+        }
+        return;
+    }
+
+    if (mem_region_cnt == MEM_REGION_MAX) {
+        put_str("      too many memory regions, ignored one\n");
+        return;
+    }
+    for (j = mem_region_cnt; j > i; j--)
+        mem_regions[j] = mem_regions[j - 1];
+    mem_regions[i].start = start;
+    mem_regions[i].end = end;
+    mem_region_cnt++;
+}
+
+/**
+ * mem_region_cut - 从可用物理内存中去掉 [start, end)，用于排除保留区域。
+ * @start: 起始物理地址，页对齐。
+ * @end: 结束物理地址（不含），页对齐。
+ */
+static void mem_region_cut(uint32_t start, uint32_t end) {
+    uint32_t i, j;
+    for (i = 0; i < mem_region_cnt; i++) {
+        struct mem_region *r = &mem_regions[i];
+        if (r->end <= start || r->start >= end)
+            continue;
+        if (r->start < start && r->end > end) {
+            /* 落在区间中间，一分为二；区间互不重叠，因此不会再影响其他区间 */
+            uint32_t tail_end = r->end;
+            r->end = start;
+            mem_region_add(end, tail_end);
+            return;
+        }
+        if (r->start < start) {
+            r->end = start;
+        } else if (r->end > end) {
+            r->start = end;
+        } else {
+            r->start = r->end;
+        }
+    }
+    /* 删除被完全去掉的区间 */
+    for (i = 0, j = 0; i < mem_region_cnt; i++) {
+        if (mem_regions[i].start < mem_regions[i].end)
+            mem_regions[j++] = mem_regions[i];
+    }
+    mem_region_cnt = j;
+}
+
+/**
+ * mem_regions_init - 根据加载器保存的 E820 内存布局建立可用物理内存区间表。
+ * @all_mem: 加载器得到的内存容量，E820 失败而改用 0xe801/0x88 子功能时只有这个数值可用。
+ *
+ * 先加入所有可用（type 1）区域，再去掉保留、ACPI 等其他类型的区域以及低 2MB。
+ * 可用区域向内按页对齐，不可用区域向外按页对齐。4GB 以上的内存无法在 32 位分页下使用，直接忽略。
+ */
+static void mem_regions_init(uint32_t all_mem) {
+    struct ards *ards = (struct ards *)ARDS_BUF_ADDR;
+    uint16_t ards_nr = *(uint16_t *)ARDS_NR_ADDR;
+    uint32_t i;
+
+    mem_region_cnt = 0;
+    if (ards_nr == 0)
+        mem_region_add(0, all_mem & 0xfffff000);
+
+    for (i = 0; i < ards_nr; i++) {
+        if (ards[i].type != ARDS_TYPE_USABLE || ards[i].base_high != 0 || ards[i].base_low > 0xfffff000)
+            continue;
+        uint32_t end = ards[i].base_low + ards[i].length_low;
+        if (ards[i].length_high != 0 || end < ards[i].base_low)
+            end = 0xfffff000;
+        mem_region_add((ards[i].base_low + PAGE_SIZE - 1) & 0xfffff000, end & 0xfffff000);
+    }
+    for (i = 0; i < ards_nr; i++) {
+        if (ards[i].type == ARDS_TYPE_USABLE || ards[i].base_high != 0)
+            continue;
+        uint32_t end = ards[i].base_low + ards[i].length_low;
+        if (ards[i].length_high != 0 || end < ards[i].base_low || end > 0xfffff000)
+            end = 0xfffff000;
+        mem_region_cut(ards[i].base_low & 0xfffff000, (end + PAGE_SIZE - 1) & 0xfffff000);
+    }
+    mem_region_cut(0, LOW_MEM_RESERVED);
+    ASSERT(mem_region_cnt > 0);
+
+    for (i = 0; i < mem_region_cnt; i++) {
+        put_str("      usable memory: ");
+        put_int(mem_regions[i].start);
+        put_str(" ~ ");
+        put_int(mem_regions[i].end);
+        put_str("\n");
+    }
+}
+
+/**
+ * mem_region_addr_after - 返回可用物理内存中前 pg_cnt 个页框之后的物理地址。
+ * @pg_cnt: 页框数量。
+ *
+ * 用于在可用区间上划分内核与用户内存池的分界，区间之间的空洞不计入页框数。
+ */
+static uint32_t mem_region_addr_after(uint32_t pg_cnt) {
+    uint32_t i;
+    for (i = 0; i < mem_region_cnt; i++) {
+        uint32_t region_pages = (mem_regions[i].end - mem_regions[i].start) / PAGE_SIZE;
+        if (pg_cnt <= region_pages)
+            return mem_regions[i].start + pg_cnt * PAGE_SIZE;
+        pg_cnt -= region_pages;
+    }
+    return mem_regions[mem_region_cnt - 1].end;
+}
 
 /**
  * mem_pool_init() - 初始化内核和用户的物理和虚拟内存池。
- * @all_mem: 总物理内存大小。
+ * @all_mem: 加载器得到的内存容量，仅在没有 E820 内存布局时使用。
  *
  * 此函数初始化内核和用户的内存池。
- * 它计算并将可用内存分配给内核和用户空间，考虑到内核已使用的内存。
- * 它初始化这些内存池的位图，以跟踪空闲和已使用的页面。
- * 该函数还设置内核和用户内存池的起始地址和大小。
+ * 它按 E820 内存布局得到所有可用物理内存，把其中一半（不超过 KERNEL_POOL_MAX_PAGES 个页框）分给内核，
+ * 其余分给用户。每个内存池覆盖一段连续的物理地址，其中的空洞和保留区域在伙伴系统初始化时不会被释放，
+ * 因而永远不会被分配。内存池的位图与页框描述符一起在 buddy_init 中分配。
  * 此外，它初始化了内核的虚拟地址池。
  *
  * 上下文: 在系统初始化期间应调用此函数，为内核和用户空间设置内存池。
@@ -60,83 +361,53 @@ static void mem_pool_init(uint32_t all_mem) {
 
     lock_init(&kernel_pool._lock);
     lock_init(&user_pool._lock);
-    
-    /* 1 页目录表（PDT）+ 255 页表（PT）= 4KB * 256 = 1024KB = 1MB（0x100000B） */
-    uint32_t page_table_size = PAGE_SIZE * 256;
 
-    /* 0x100000 是内核使用的低1MB物理空间 */
-    /* 因此 used_mem 的值为 2MB（0x200000）*/
-    uint32_t used_mem = page_table_size + 0x100000;
-    uint32_t free_mem = all_mem - used_mem;
+    mem_regions_init(all_mem);
 
-    /* 忽略小于页面大小的物理内存 */
-    uint16_t all_free_pages = free_mem / PAGE_SIZE;
+    uint32_t all_free_pages = 0, i;
+    for (i = 0; i < mem_region_cnt; i++)
+        all_free_pages += (mem_regions[i].end - mem_regions[i].start) / PAGE_SIZE;
 
     /* 分配给内核和用户内存池的空闲物理页 */
-    uint16_t kernel_free_pages = all_free_pages / 2;
-    uint16_t user_free_pages = all_free_pages - kernel_free_pages;
-
-    /* 内核和用户内存池位图的长度 */
-    uint32_t kernel_bitmap_len = kernel_free_pages / 8;
-    uint32_t user_bitmap_len = user_free_pages / 8;
+    uint32_t kernel_free_pages = all_free_pages / 2;
+    if (kernel_free_pages > KERNEL_POOL_MAX_PAGES)
+        kernel_free_pages = KERNEL_POOL_MAX_PAGES;
 
-    /* 内核和用户内存池的起始地址*/
-    uint32_t kernel_pool_start = used_mem;
-    uint32_t user_pool_start = kernel_pool_start + kernel_free_pages * PAGE_SIZE;
+    /* 内核和用户内存池的起止地址 */
+    uint32_t kernel_pool_start = mem_regions[0].start;
+    uint32_t user_pool_start = mem_region_addr_after(kernel_free_pages);
+    uint32_t user_pool_end = mem_regions[mem_region_cnt - 1].end;
 
     kernel_pool.phy_addr_start = kernel_pool_start;
-    kernel_pool.pool_size = kernel_free_pages * PAGE_SIZE;
-    kernel_pool.pool_bitmap.bmap_bytes_len = kernel_bitmap_len;
-    kernel_pool.pool_bitmap.bits = (void *)MEM_BITMAP_BASE;
+    kernel_pool.pool_size = user_pool_start - kernel_pool_start;
 
     user_pool.phy_addr_start = user_pool_start;
-    user_pool.pool_size = user_free_pages * PAGE_SIZE;
-    user_pool.pool_bitmap.bmap_bytes_len = user_bitmap_len;
-    user_pool.pool_bitmap.bits = (void *)(MEM_BITMAP_BASE + kernel_bitmap_len);
+    user_pool.pool_size = user_pool_end - user_pool_start;
 
-    put_str("      kernel_pool_bitmap_start: ");
-    put_int((int)kernel_pool.pool_bitmap.bits);
-    put_str("\n");
     put_str("      kernel_pool_phy_start:    ");
     put_int(kernel_pool.phy_addr_start);
     put_str("\n");
-
-    put_str("      user_pool_bitmap_start:   ");
-    put_int((int)user_pool.pool_bitmap.bits);
-    put_str("\n");
     put_str("      user_pool_phy_start:      ");
     put_int(user_pool.phy_addr_start);
     put_str("\n");
+    put_str("      user_pool_phy_end:        ");
+    put_int(user_pool_end);
+    put_str("\n");
 
-    bitmap_init(&kernel_pool.pool_bitmap);
-    bitmap_init(&user_pool.pool_bitmap);
-
-    /* 初始化内核虚拟地址位图，并按实际物理内存大小生成数组*/
-    kernel_vaddr.vaddr_bitmap.bmap_bytes_len = kernel_bitmap_len;
-    kernel_vaddr.vaddr_bitmap.bits = (void *)(MEM_BITMAP_BASE + kernel_bitmap_len + user_bitmap_len);
+    /* 初始化内核虚拟地址位图，按内核内存池的页框数生成数组，但不超出预先建立的内核页表覆盖的范围 */
+    uint32_t kernel_vaddr_bitmap_len = kernel_free_pages / 8;
+    if (kernel_vaddr_bitmap_len > KERNEL_HEAP_PAGES / 8)
+        kernel_vaddr_bitmap_len = KERNEL_HEAP_PAGES / 8;
+    kernel_vaddr.vaddr_bitmap.bmap_bytes_len = kernel_vaddr_bitmap_len;
+    kernel_vaddr.vaddr_bitmap.bits = (void *)MEM_BITMAP_BASE;
+    /* 摘要位图紧随其后，按4字节对齐 */
+    kernel_vaddr.vaddr_bitmap.summary = (void *)((MEM_BITMAP_BASE + kernel_vaddr_bitmap_len + 3) & 0xfffffffc);
     kernel_vaddr.vaddr_start = KERNEL_HEAP_START;
 
     bitmap_init(&kernel_vaddr.vaddr_bitmap);
     put_str("    mem_pool_init done\n");
 }
 
-/*
- * mem_init() - 内存管理初始化的入口点。
- *
- * 此函数标记了内存初始化的开始。首先打印一条消息表示内存初始化的开始。
- * 然后读取总内存大小，并使用此大小初始化内存池。
- * 最后，初始化内存块描述符数组，这对于 malloc 函数是至关重要的，并打印完成消息。
- *
- * 上下文: 此函数对于设置内存管理系统至关重要。它初始化内存池并准备用于动态内存分配的内存块描述符。
- * 返回值: 此函数不返回值。
- */
-void mem_init() {
-    put_str("  mem_init start\n");
-    uint32_t mem_bytes_total = (*(uint32_t *)(0xb00));
-    mem_pool_init(mem_bytes_total);
-    put_str("  mem_init done\n");
-}
-
 /**
  * vaddr_get - 从虚拟内存池pf请求pg_cnt个虚拟页面。
  * @pf: 虚拟内存池。
@@ -146,33 +417,65 @@ void mem_init() {
  */
 static void *vaddr_get(enum pool_flags pf, uint32_t pg_cnt) {
     int vaddr_start = 0, free_bit_idx_start = -1;
-    uint32_t cnt = 0;
 
     if (pf == PF_KERNEL) {
         free_bit_idx_start = bitmap_scan(&kernel_vaddr.vaddr_bitmap, pg_cnt);
         if (free_bit_idx_start == -1)
             return NULL;
-        while (cnt < pg_cnt) {
-            bitmap_set(&kernel_vaddr.vaddr_bitmap, free_bit_idx_start + cnt++, 1);
-        }
+        bitmap_set_range(&kernel_vaddr.vaddr_bitmap, free_bit_idx_start, pg_cnt, 1);
         vaddr_start = kernel_vaddr.vaddr_start + free_bit_idx_start * PAGE_SIZE;
     } else {
-        /* 用户进程 */
+        /* 用户进程，在其虚拟内存区域树中找一段空闲地址 */
         struct task_struct *cur = running_thread();
-        free_bit_idx_start = bitmap_scan(&cur->userprog_vaddr.vaddr_bitmap, pg_cnt);
-        if (free_bit_idx_start == -1){
+        vaddr_start = vma_alloc(&cur->userprog_vmas, pg_cnt, 0);
+        if (vaddr_start == 0)
             return NULL;
-        }
-            
-        while (cnt < pg_cnt) {
-            bitmap_set(&cur->userprog_vaddr.vaddr_bitmap, free_bit_idx_start + cnt++,1);
-        }
-        vaddr_start = cur->userprog_vaddr.vaddr_start + free_bit_idx_start * PAGE_SIZE;
-        ASSERT((uint32_t)vaddr_start < (0xc0000000 - PAGE_SIZE));
     }
     return (void *)vaddr_start;
 }
 
+/**
+ * vaddr_remove - 在虚拟地址池中释放以 _vaddr 起始的 pg_cnt 个虚拟页面
+ * @pf: 虚拟地址所属的池
+ * @_vaddr: 起始虚拟地址
+ * @pg_cnt: 虚拟页面数量
+ */
+static void vaddr_remove(enum pool_flags pf, void *_vaddr, uint32_t pg_cnt) {
+    uint32_t bit_idx_start = 0, vaddr = (uint32_t)_vaddr;
+
+    if (pf == PF_KERNEL) {
+        lock_acquire(&kernel_pool._lock);
+        bit_idx_start = (vaddr - kernel_vaddr.vaddr_start) / PAGE_SIZE;
+        bitmap_set_range(&kernel_vaddr.vaddr_bitmap, bit_idx_start, pg_cnt, 0);
+        lock_release(&kernel_pool._lock);
+    } else {
+        struct task_struct *cur_thread = running_thread();
+        vma_remove(&cur_thread->userprog_vmas, vaddr, vaddr + pg_cnt * PAGE_SIZE);
+    }
+}
+
+/**
+ * vaddr_get_large_aligned - 为用户进程申请起始地址 4MB 对齐的 pg_cnt 个虚拟页面
+ * @pg_cnt: 虚拟页面数量
+ *
+ * 先多申请 LARGE_PAGE_CNT - 1 个页面，再把对齐地址之前和所需范围之后多出的页面归还，
+ * 使其中尽可能多的部分能用 4MB 大页映射。多申请失败时退回普通的申请。
+ */
+static void *vaddr_get_large_aligned(uint32_t pg_cnt) {
+    uint32_t raw = (uint32_t)vaddr_get(PF_USER, pg_cnt + LARGE_PAGE_CNT - 1);
+    if (raw == 0)
+        return vaddr_get(PF_USER, pg_cnt);
+
+    uint32_t aligned = (raw + LARGE_PAGE_CNT * PAGE_SIZE - 1) & 0xffc00000;
+    uint32_t head_cnt = (aligned - raw) / PAGE_SIZE;
+    uint32_t tail_cnt = LARGE_PAGE_CNT - 1 - head_cnt;
+    if (head_cnt > 0)
+        vaddr_remove(PF_USER, (void *)raw, head_cnt);
+    if (tail_cnt > 0)
+        vaddr_remove(PF_USER, (void *)(aligned + pg_cnt * PAGE_SIZE), tail_cnt);
+    return (void *)aligned;
+}
+
 /**
  * pte_ptr - 计算给定虚拟地址的页表项的虚拟地址。
  * @vaddr: 要查找相应页表项的虚拟地址。
@@ -203,198 +506,1520 @@ uint32_t *pde_ptr(uint32_t vaddr) {
     return pde;
 }
 
+/* tlb_invalidate - 使虚拟地址 vaddr 所在页面在 TLB 中的缓存失效 */
+static void tlb_invalidate(uint32_t vaddr) {
+    asm volatile("invlpg %0" ::"m"(*(char *)vaddr) : "memory");
+}
+
 /**
- * palloc - 从给定的内存池分配一个物理页面。
- * @m_pool: 指向要分配页面的内存池的指针。
+ * buddy_free_block - 将一个空闲块归还给伙伴系统，并与空闲的伙伴块合并。
+ * @m_pool: 空闲块所属的内存池。
+ * @idx: 空闲块首页框在内存池中的下标。
+ * @order: 空闲块的阶数。
  *
- * 从指定的物理内存池中分配一个物理页面。
- * 函数搜索内存池位图中的空闲位，将其标记为已使用，并返回分配的页面的物理地址。
+ * 伙伴按物理页框号对齐计算：页框号为 pfn 的 k 阶块，其伙伴块的页框号为 pfn ^ (1 << k)。
+ * 只要伙伴块完整地位于内存池内、是空闲块首页框且阶数相同，就把它从链表摘下并合并成更高一阶的块，
+ * 直到无法合并或达到 BUDDY_MAX_ORDER。调用者需持有内存池的锁。
+ */
+static void buddy_free_block(struct pool *m_pool, uint32_t idx, uint8_t order) {
+    uint32_t base_pfn = m_pool->phy_addr_start / PAGE_SIZE;
+    uint32_t pg_total = m_pool->pool_size / PAGE_SIZE;
+    m_pool->free_pages += 1 << order;
+    bitmap_set_range(&m_pool->pool_bitmap, idx, 1 << order, 0);
+
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy_pfn = (base_pfn + idx) ^ (1 << order);
+        if (buddy_pfn < base_pfn || buddy_pfn - base_pfn + (1 << order) > pg_total)
+            break;
+        struct page_frame *buddy = &m_pool->frames[buddy_pfn - base_pfn];
+        if (!(buddy->flags & FRAME_FREE_HEAD) || buddy->order != order)
+            break;
+        list_remove(&buddy->free_tag);
+        buddy->flags &= ~FRAME_FREE_HEAD;
+        if (buddy_pfn - base_pfn < idx)
+            idx = buddy_pfn - base_pfn;
+        order++;
+    }
+    m_pool->frames[idx].order = order;
+    m_pool->frames[idx].flags |= FRAME_FREE_HEAD;
+    list_push(&m_pool->free_area[order], &m_pool->frames[idx].free_tag);
+}
+
+/**
+ * buddy_free_range - 将内存池中一段连续的页框归还给伙伴系统。
+ * @m_pool: 页框所属的内存池。
+ * @idx: 起始页框在内存池中的下标。
+ * @pg_cnt: 页框数量。
  *
- * 返回值: 分配的物理页面的起始指针，如果没有可用的空闲页面则返回NULL。
+ * 按页框号对齐把区间拆成尽可能大的块逐个归还，用于初始化空闲链表和归还多余的尾部页框。
  */
-static void *palloc(struct pool *m_pool) {
-    int bit_idx = bitmap_scan(&m_pool->pool_bitmap, 1);
-    if (bit_idx == -1)
-        return NULL;
-    bitmap_set(&m_pool->pool_bitmap, bit_idx, 1);
-    uint32_t page_phy_addr = m_pool->phy_addr_start + bit_idx * PAGE_SIZE;
-    return (void *)page_phy_addr;
+static void buddy_free_range(struct pool *m_pool, uint32_t idx, uint32_t pg_cnt) {
+    uint32_t base_pfn = m_pool->phy_addr_start / PAGE_SIZE;
+    while (pg_cnt > 0) {
+        uint8_t order = 0;
+        while (order < BUDDY_MAX_ORDER && !((base_pfn + idx) & (1 << order)) &&
+               (2u << order) <= pg_cnt)
+            order++;
+        buddy_free_block(m_pool, idx, order);
+        idx += 1 << order;
+        pg_cnt -= 1 << order;
+    }
 }
 
 /**
- * page_table_Add() - 在虚拟地址和物理地址之间建立映射关系。
- * @_vaddr: 虚拟地址。
- * @_page_phy_addr: 物理地址。
+ * buddy_alloc - 从伙伴系统中分配一个 2^order 个页框的块。
+ * @m_pool: 要分配的内存池。
+ * @order: 块的阶数。
  *
- * 此函数为给定的虚拟地址设置页表项（PTE）。
- * 它涉及检查给定虚拟地址的页目录项（PDE）是否存在。
- * 如果PDE存在，表示存在页表，则函数继续创建PTE。
- * 在设置PTE之前，它确保PTE不存在。
- * 如果PDE不存在，则在内核空间为页表分配一个物理页面，
- * 初始化这个新的页表（设置为0），然后创建PTE。
- * 函数使用位操作来设置PDE和PTE中的正确标志以进行映射。
+ * 从 order 阶开始向上找到第一个非空的空闲链表，取出一个块，然后逐级对半拆分，
+ * 把拆出的后半块挂回低一阶的链表，直到得到 order 阶的块。调用者需持有内存池的锁。
  *
- * 上下文: 此函数应在可以安全修改页表的上下文中调用。
- * 它假定内核页池已经初始化。
- * 返回值: 此函数不返回值。
+ * 返回值: 块首页框在内存池中的下标，没有足够大的空闲块时返回 -1。
+ */
+static int32_t buddy_alloc(struct pool *m_pool, uint8_t order) {
+    uint8_t cur_order = order;
+    while (cur_order <= BUDDY_MAX_ORDER && list_empty(&m_pool->free_area[cur_order]))
+        cur_order++;
+    if (cur_order > BUDDY_MAX_ORDER)
+        return -1;
+
+    struct page_frame *frame =
+        elem2entry(struct page_frame, free_tag, list_pop(&m_pool->free_area[cur_order]));
+    frame->flags &= ~FRAME_FREE_HEAD;
+    uint32_t idx = frame - m_pool->frames;
+
+    while (cur_order > order) {
+        cur_order--;
+        struct page_frame *half = &m_pool->frames[idx + (1 << cur_order)];
+        half->order = cur_order;
+        half->flags |= FRAME_FREE_HEAD;
+        list_push(&m_pool->free_area[cur_order], &half->free_tag);
+    }
+
+    m_pool->free_pages -= 1 << order;
+    bitmap_set_range(&m_pool->pool_bitmap, idx, 1 << order, 1);
+    return idx;
+}
+
+/**
+ * pool_used_add - 调整内存池中已交给调用者的页框数
+ * @m_pool: 内存池
+ * @delta: 增量，归还页框时为负
  *
- * 注意: 此函数使用ASSERT来确保在设置新的PTE时PTE不存在。
- * 它还执行必要的位操作来设置页表条目中的标志。
+ * 页框弹匣的快速路径不持有内存池的锁，关中断保证计数的读改写不被打断。
  */
-static void page_table_add(void *_vaddr, void *_page_phy_addr) {
-    uint32_t vaddr = (uint32_t)_vaddr;
-    uint32_t page_phy_addr = (uint32_t)_page_phy_addr;
-    uint32_t *pde = pde_ptr(vaddr);
-    uint32_t *pte = pte_ptr(vaddr);
+static void pool_used_add(struct pool *m_pool, int32_t delta) {
+    enum intr_status old_status = intr_disable();
+    m_pool->used_pages += delta;
+    intr_set_status(old_status);
+}
 
-    /* 通过位是否存在检查PDE是否存在 */
-    if (*pde & 0x00000001) {
-        /* PDE 存在，这意味着页表存在，所以只需创建 PTE */
+/**
+ * pt_pages_add - 调整用户空间页表占用的页框数
+ * @delta: 增量
+ */
+static void pt_pages_add(int32_t delta) {
+    enum intr_status old_status = intr_disable();
+    pt_pages += delta;
+    intr_set_status(old_status);
+}
 
-        /* 确保 PTE 不存在 */
-        ASSERT(!(*pte & 0x00000001));
-        
-        if(!(*pte & 0x00000001)){
-            *pte = (page_phy_addr | PG_US_U | PG_RW_W | PG_P_1);
-        } else {
-            PANIC("pte repeat");
-            *pte = (page_phy_addr | PG_US_U | PG_RW_W | PG_P_1);
-        }
-        
+/**
+ * magazine_get - 获取当前任务对应内存池的页框弹匣。
+ * @m_pool: 内存池。
+ *
+ * 在 thread_init 之前主线程的 PCB 尚未初始化，此时返回 NULL，调用者直接使用共享内存池。
+ */
+static struct page_magazine *magazine_get(struct pool *m_pool) {
+    struct task_struct *cur_thread = running_thread();
+    if (cur_thread->stack_magic != STACK_MAGIC)
+        return NULL;
+    return &cur_thread->page_mag[m_pool == &kernel_pool ? MAG_KERNEL : MAG_USER];
+}
+
+/**
+ * magazine_refill - 从共享内存池一次性补充 MAG_BATCH 个页框到弹匣。
+ * @m_pool: 内存池。
+ * @mag: 要补充的弹匣。
+ *
+ * 优先申请一个 MAG_BATCH 页的块，这样只需一次伙伴系统操作；内存池碎片化时退化为逐页申请。
+ */
+static void magazine_refill(struct pool *m_pool, struct page_magazine *mag) {
+    uint8_t batch_order = 0;
+    while ((1 << batch_order) < MAG_BATCH)
+        batch_order++;
+
+    lock_acquire(&m_pool->_lock);
+    int32_t idx = buddy_alloc(m_pool, batch_order);
+    if (idx != -1) {
+        uint32_t cnt = MAG_BATCH;
+        while (cnt-- > 0)
+            mag->frames[mag->cnt++] = m_pool->phy_addr_start + (idx + cnt) * PAGE_SIZE;
     } else {
-        /* PDE 不存在，这意味着页表不存在，因此在 kernel_pool 中申请一个物理页面作为页表 */
-        uint32_t pde_phy_addr = (uint32_t)palloc(&kernel_pool);
-        *pde = (pde_phy_addr | PG_US_U | PG_RW_W | PG_P_1);
-        /* memset 需要一个虚拟地址。通过 pte 的值获取页表的虚拟地址 */
-        memset((void *)((int)pte & 0xfffff000), 0, PAGE_SIZE);
+        while (mag->cnt < MAG_BATCH && (idx = buddy_alloc(m_pool, 0)) != -1)
+            mag->frames[mag->cnt++] = m_pool->phy_addr_start + idx * PAGE_SIZE;
+    }
+    lock_release(&m_pool->_lock);
+}
 
-        ASSERT(!(*pte & 0x00000001));
-        *pte = (page_phy_addr | PG_US_U | PG_RW_W | PG_P_1);
+/**
+ * magazine_drain - 把弹匣中的 MAG_BATCH 个页框归还给共享内存池。
+ * @m_pool: 内存池。
+ * @mag: 要归还页框的弹匣。
+ */
+static void magazine_drain(struct pool *m_pool, struct page_magazine *mag) {
+    lock_acquire(&m_pool->_lock);
+    uint32_t cnt = MAG_BATCH;
+    while (cnt-- > 0 && mag->cnt > 0) {
+        uint32_t pg_phy_addr = mag->frames[--mag->cnt];
+        buddy_free_block(m_pool, (pg_phy_addr - m_pool->phy_addr_start) / PAGE_SIZE, 0);
     }
+    lock_release(&m_pool->_lock);
+}
+
+/* zero_reserve_get - 获取内存池对应的已清零页框储备 */
+static struct zero_reserve *zero_reserve_get(struct pool *m_pool) {
+    return &zero_reserves[m_pool == &kernel_pool ? MAG_KERNEL : MAG_USER];
 }
 
 /**
- * malloc_page() - 分配指定数量的页面空间。
- * @pf: 指示要使用哪个内存池的标志。
- * @pg_cnt: 要分配的页面数量。
+ * zero_frame_take - 从已清零页框储备中取出一个页框
+ * @m_pool: 内存池
  *
- * 此函数分配 'pg_cnt' 个虚拟内存页面，并建立虚拟页面和物理页面之间的映射关系。
- * 它确保请求不会超过总物理内存大小。
- * 函数首先分配虚拟页面，然后对于每个虚拟页面，它分配一个相应的物理页面，并设置页表项（PTE）和可能的页目录项（PDE）。
- * 如果在任何时候分配失败，函数将返回NULL。
+ * 储备降到 ZERO_RESERVE_LOW 以下且清零线程正在阻塞时将其唤醒。
  *
- * 上下文: 根据池标志，用于在内核或用户空间中分配内存。
- * 返回值: 如果成功，则返回已分配虚拟页面的起始地址，否则返回NULL。
+ * 返回值: 页框的物理地址，储备为空时返回 NULL。
  */
-void *malloc_page(enum pool_flags pf, uint32_t pg_cnt) {
-    /* 确保由 pg_cnt 表示的内存大小不超过总物理内存大小。15MB/4KB = 3840 */
-    ASSERT(pg_cnt > 0 && pg_cnt < 3840);
-    /* 分配虚拟页面 */
-    void *vaddr_start = vaddr_get(pf, pg_cnt);
-    if (vaddr_start == NULL)
-        return NULL;
-
-    uint32_t vaddr = (uint32_t)vaddr_start;
-    uint32_t cnt = pg_cnt;
-    struct pool *mem_pool = (pf & PF_KERNEL) ? &kernel_pool : &user_pool;
+static void *zero_frame_take(struct pool *m_pool) {
+    struct zero_reserve *reserve = zero_reserve_get(m_pool);
+    uint32_t pg_phy_addr = 0;
 
-    /* 在相应的池中分配物理页面，即建立虚拟页面和物理页面之间的映射关系，即创建PTE（可能还有PDE） */
-    while (cnt-- > 0) {
-        void *page_phy_addr = palloc(mem_pool);
-        if (page_phy_addr == NULL)
-            return NULL;
-        page_table_add((void *)vaddr, page_phy_addr);
-        vaddr += PAGE_SIZE;
+    enum intr_status old_status = intr_disable();
+    if (reserve->cnt > 0) {
+        pg_phy_addr = reserve->frames[--reserve->cnt];
+        m_pool->used_pages++;
     }
-    return vaddr_start;
+    if (zero_thread_idle && reserve->cnt < ZERO_RESERVE_LOW) {
+        zero_thread_idle = false;
+        thread_unblock(zero_thread);
+    }
+    intr_set_status(old_status);
+    return (void *)pg_phy_addr;
 }
 
 /**
- * get_kernel_pages() - 分配内核页面并将其初始化为零。
- * @pg_cnt: 要分配的页面数量。
+ * palloc_noswap - 从给定的内存池分配一个物理页面，不换出页面。
+ * @m_pool: 指向要分配页面的内存池的指针。
  *
- * 此函数是 malloc_page 的一个特定于内核内存分配的包装器。
- * 它使用 malloc_page 在内核空间中分配 'pg_cnt' 个页面。
- * 如果成功，然后将分配的内存初始化为零。
- * 这特别用于内核空间内存分配，其中需要初始化。
+ * 优先从当前任务的页框弹匣中取，这条路径不获取任何锁；弹匣为空时先从伙伴系统批量补充。
+ * 伙伴系统也耗尽时，最后动用已清零页框储备。
  *
- * 上下文: 当需要内核空间内存，并且需要将分配的内存初始化为零时使用。
- * 返回值: 如果成功，则返回已分配和初始化的虚拟页面的起始地址，否则返回NULL。
+ * 返回值: 分配的物理页面的起始指针，如果没有可用的空闲页面则返回NULL。
  */
-void *get_kernel_pages(uint32_t pg_cnt) {
-    void *vaddr = malloc_page(PF_KERNEL, pg_cnt);
-    if (vaddr != NULL)
-        memset(vaddr, 0, pg_cnt * PAGE_SIZE);
-    return vaddr;
+static void *palloc_noswap(struct pool *m_pool) {
+    struct page_magazine *mag = magazine_get(m_pool);
+    if (mag != NULL) {
+        if (mag->cnt == 0)
+            magazine_refill(m_pool, mag);
+        if (mag->cnt == 0)
+            return zero_frame_take(m_pool);
+        pool_used_add(m_pool, 1);
+        return (void *)mag->frames[--mag->cnt];
+    }
+
+    lock_acquire(&m_pool->_lock);
+    int32_t idx = buddy_alloc(m_pool, 0);
+    lock_release(&m_pool->_lock);
+    if (idx == -1)
+        return zero_frame_take(m_pool);
+    pool_used_add(m_pool, 1);
+    uint32_t page_phy_addr = m_pool->phy_addr_start + idx * PAGE_SIZE;
+    return (void *)page_phy_addr;
 }
 
 /**
- * get_user_page - 分配用户空间页面
- * @pg_cnt: 要分配的4K页面数量
- * 返回：分配的用户空间内存的虚拟地址
+ * palloc - 从给定的内存池分配一个物理页面。
+ * @m_pool: 指向要分配页面的内存池的指针。
  *
- * 在用户空间分配'pg_cnt'数量的4K页面，初始化分配的空间为零，并返回分配空间的虚拟地址。
- * 通过在用户内存池上获取锁来确保分配期间的互斥。
+ * 用户内存池耗尽时把不常用的用户页面换出到交换区再重试，直到交换区也无能为力。
+ *
+ * 返回值: 分配的物理页面的起始指针，如果没有可用的空闲页面则返回NULL。
  */
+void *palloc(struct pool *m_pool) {
+    void *page_phy_addr = palloc_noswap(m_pool);
+    while (page_phy_addr == NULL && m_pool == &user_pool && swap_reclaim(SWAP_RECLAIM_BATCH) > 0)
+        page_phy_addr = palloc_noswap(m_pool);
+    return page_phy_addr;
+}
 
-void *get_user_page(uint32_t pg_cnt) {
-    lock_acquire(&user_pool._lock);
-    void *vaddr = malloc_page(PF_USER, pg_cnt);
-    if (vaddr != NULL){
-        memset(vaddr, 0, pg_cnt * PAGE_SIZE);
+/**
+ * palloc_zeroed - 为需要清零的页面分配物理页框
+ * @m_pool: 内存池
+ * @zeroed: 输出参数，页框是否已经清零
+ *
+ * 优先从已清零页框储备中取，命中时调用者可以省去清零；储备为空时退回 palloc，并统计命中与未命中次数。
+ */
+void *palloc_zeroed(struct pool *m_pool, bool *zeroed) {
+    struct zero_reserve *reserve = zero_reserve_get(m_pool);
+    void *page_phy_addr = zero_frame_take(m_pool);
+    if (page_phy_addr != NULL) {
+        reserve->hits++;
+        *zeroed = true;
+        return page_phy_addr;
     }
-    lock_release(&user_pool._lock);
-    return vaddr;
+    reserve->misses++;
+    *zeroed = false;
+    return palloc(m_pool);
 }
 
 /**
- * get_a_page - 将虚拟地址映射到物理页面
- * @pf: 池标志，指示页面是为用户还是内核
- * @vaddr: 要映射的虚拟地址
- * 返回：成功时返回虚拟地址‘vaddr’，失败时返回NULL
+ * palloc_contig - 从内存池分配物理地址连续的 pg_cnt 个页框。
+ * @m_pool: 要分配的内存池。
+ * @pg_cnt: 页框数量，最多 2^BUDDY_MAX_ORDER 个。
  *
- * 将给定的虚拟地址‘vaddr’映射到指定池‘pf’（用户或内核）的物理页面。
- * 该函数首先在内存池上获取锁，计算来自虚拟地址的位图索引，设置位图中相应的位以指示页面被使用，
- * 分配一个物理页面，并添加虚拟地址与物理页面之间的映射。返回前释放锁。如果物理页面分配失败，则返回NULL。
+ * 分配能容纳 pg_cnt 的最小阶数的块，再把超出 pg_cnt 的尾部页框归还给伙伴系统。
+ * 用于 DMA 缓冲区等必须物理连续的场景，调用者自行建立映射。
+ *
+ * 返回值: 起始页框的物理地址，失败时返回 NULL。
  */
+void *palloc_contig(struct pool *m_pool, uint32_t pg_cnt) {
+    ASSERT(pg_cnt > 0 && pg_cnt <= (1 << BUDDY_MAX_ORDER));
+    uint8_t order = 0;
+    while ((1u << order) < pg_cnt)
+        order++;
 
-void *get_a_page(enum pool_flags pf, uint32_t vaddr) {
-    struct pool *mem_pool = pf & PF_KERNEL ? &kernel_pool : &user_pool;
-    lock_acquire(&mem_pool->_lock);
-    struct task_struct *cur_thread = running_thread();
-    int32_t bit_idx = -1;
-
-    if (cur_thread->pg_dir != NULL && pf == PF_USER) {
-        bit_idx = (vaddr - cur_thread->userprog_vaddr.vaddr_start) / PAGE_SIZE;
-        ASSERT(bit_idx > 0);
-        bitmap_set(&cur_thread->userprog_vaddr.vaddr_bitmap, bit_idx, 1);
-    } else if (cur_thread->pg_dir == NULL && pf == PF_KERNEL) {
-        bit_idx = (vaddr - kernel_vaddr.vaddr_start) / PAGE_SIZE;
-        ASSERT(bit_idx > 0);
-        bitmap_set(&kernel_vaddr.vaddr_bitmap, bit_idx, 1);
-    } else {
-        PANIC("Unable to establish mapping between pf and vaddr");
-    }
-    void *page_phy_addr = palloc(mem_pool);
-    if (page_phy_addr == NULL) {
-        //lock_release(&mem_pool->_lock);
+    lock_acquire(&m_pool->_lock);
+    int32_t idx = buddy_alloc(m_pool, order);
+    if (idx == -1) {
+        lock_release(&m_pool->_lock);
         return NULL;
     }
-    page_table_add((void *)vaddr, page_phy_addr);
-    lock_release(&mem_pool->_lock);
-    return (void *)vaddr;
+    if ((1u << order) > pg_cnt)
+        buddy_free_range(m_pool, idx + pg_cnt, (1 << order) - pg_cnt);
+    m_pool->used_pages += pg_cnt;
+    lock_release(&m_pool->_lock);
+    return (void *)(m_pool->phy_addr_start + idx * PAGE_SIZE);
 }
 
 /**
- * addr_v2p - 将虚拟地址转换为物理地址
- * @vaddr: 要转换的虚拟地址
- * 返回：相应的物理地址
+ * pfree_contig - 归还 palloc_contig 分配的连续页框。
+ * @m_pool: 页框所属的内存池。
+ * @pg_phy_addr: 起始页框的物理地址。
+ * @pg_cnt: 页框数量，须与分配时一致。
+ */
+void pfree_contig(struct pool *m_pool, void *pg_phy_addr, uint32_t pg_cnt) {
+    uint32_t idx = ((uint32_t)pg_phy_addr - m_pool->phy_addr_start) / PAGE_SIZE;
+    ASSERT((uint32_t)pg_phy_addr >= m_pool->phy_addr_start &&
+           idx + pg_cnt <= m_pool->pool_size / PAGE_SIZE);
+    lock_acquire(&m_pool->_lock);
+    buddy_free_range(m_pool, idx, pg_cnt);
+    lock_release(&m_pool->_lock);
+    pool_used_add(m_pool, -(int32_t)pg_cnt);
+}
+
+/**
+ * map_range() - 把 pg_cnt 个连续的虚拟页面映射到给定的物理页框。
+ * @vaddr: 起始虚拟地址，页对齐。
+ * @phy_addrs: 各页面对应的物理地址；为 NULL 时映射从 phy_start 开始的连续物理页框。
+ * @phy_start: phy_addrs 为 NULL 时的起始物理地址。
+ * @pg_cnt: 页面数量。
+ * @flags: PTE 属性（PG_US_U、PG_RW_W、PG_SHARED），P 位以及内核空间的 G 位会自动加上。
  *
- * 该函数使用页表条目将给定的虚拟地址转换为其对应的物理地址。
- * 它首先定位给定虚拟地址的页表条目，然后从中提取物理地址。
- * 函数结合页表条目中提取的物理页面帧地址的高20位与原始虚拟地址的低12位，形成完整的物理地址。
+ * 分两遍处理。第一遍为缺失的页表各分配一次页框，新页表在 PDE 中用 PDE_FRESH 标记，
+ * 内核内存池耗尽时把本次新分配的页表全部释放，页表保持调用前的样子。
+ * 第二遍不会失败：每个页表只经由自映射定位一次，然后在紧凑的循环中连续填写 PTE。
+ * 内核空间的页表在启动时已全部建立，因此只有用户空间的地址才会分配新页表。
+ *
+ * 上下文: 此函数应在可以安全修改页表的上下文中调用。
+ * 返回值: 成功返回 true，无法为页表分配页框时返回 false。
+ *
+ * 注意: 此函数使用ASSERT来确保在设置新的PTE时PTE不存在。
  */
-uint32_t addr_v2p(uint32_t vaddr) {
-    uint32_t *pte_phy_addr = pte_ptr(vaddr);
+bool map_range(uint32_t vaddr, const uint32_t *phy_addrs, uint32_t phy_start, uint32_t pg_cnt,
+               uint32_t flags) {
+    ASSERT(vaddr % PAGE_SIZE == 0 && pg_cnt > 0);
+    uint32_t end = vaddr + pg_cnt * PAGE_SIZE;
+    /* 内核空间在所有地址空间中都相同，标记为全局页 */
+    uint32_t global = vaddr >= 0xc0000000 ? PG_G : 0;
+    uint32_t cur;
+
+    for (cur = vaddr; cur < end; cur = (cur & 0xffc00000) + LARGE_PAGE_CNT * PAGE_SIZE) {
+        uint32_t *pde = pde_ptr(cur);
+        /* 4MB 大页覆盖的区域没有页表，不能再建立 4KB 映射 */
+        ASSERT(!(*pde & PG_PS));
+        if (*pde & PG_P_1)
+            continue;
+
+        ASSERT(cur < 0xc0000000);
+        uint32_t pt_phy_addr = (uint32_t)palloc(&kernel_pool);
+        if (pt_phy_addr == 0) {
+            uint32_t undo;
+            for (undo = vaddr; undo < cur; undo = (undo & 0xffc00000) + LARGE_PAGE_CNT * PAGE_SIZE) {
+                pde = pde_ptr(undo);
+                if (*pde & PDE_FRESH) {
+                    pfree(*pde & 0xfffff000);
+                    pt_pages_add(-1);
+                    MEM_PROFILE_FREE((*pde & 0xfffff000) + 1, 1);
+                    *pde = 0;
+                    /* 清零页表时经由自映射访问过它，撤销这一项缓存 */
+                    tlb_invalidate((uint32_t)pte_ptr(undo) & 0xfffff000);
+                }
+            }
+            return false;
+        }
+        *pde = pt_phy_addr | PDE_FRESH | PG_US_U | PG_RW_W | PG_P_1;
+        pt_pages_add(1);
+        MEM_PROFILE_ALLOC(pt_phy_addr + 1, 1);
+        /* memset 需要一个虚拟地址。经由自映射得到页表的虚拟地址 */
+        memset((void *)((uint32_t)pte_ptr(cur) & 0xfffff000), 0, PAGE_SIZE);
+    }
+
+    uint32_t idx = 0;
+    for (cur = vaddr; cur < end;) {
+        *pde_ptr(cur) &= ~PDE_FRESH;
+        uint32_t *pte = pte_ptr(cur);
+        /* 本页表中剩余的 PTE 数，不超过还需映射的页面数 */
+        uint32_t n = LARGE_PAGE_CNT - PTE_IDX(cur);
+        if (n > (end - cur) / PAGE_SIZE)
+            n = (end - cur) / PAGE_SIZE;
+
+        uint32_t i;
+        for (i = 0; i < n; i++, idx++) {
+            ASSERT(!(pte[i] & PG_P_1));
+            uint32_t page_phy_addr = phy_addrs != NULL ? phy_addrs[idx] : phy_start + idx * PAGE_SIZE;
+            pte[i] = page_phy_addr | global | flags | PG_P_1;
+        }
+        small_mappings += n;
+        cur += n * PAGE_SIZE;
+    }
+    /* 用户空间总是映射在当前任务的地址空间中 */
+    if (vaddr < 0xc0000000)
+        running_thread()->rss_pages += pg_cnt;
+    return true;
+}
+
+/**
+ * page_table_Add() - 在虚拟地址和物理地址之间建立映射关系。
+ * @_vaddr: 虚拟地址。
+ * @_page_phy_addr: 物理地址。
+ *
+ * 只映射一个页面的 map_range()，页面可被用户访问、可写。缺失的页表由 map_range() 分配，
+ * 无法分配时映射无从建立，直接 PANIC。
+ */
+static void page_table_add(void *_vaddr, void *_page_phy_addr) {
+    if (!map_range((uint32_t)_vaddr, NULL, (uint32_t)_page_phy_addr, 1, PG_US_U | PG_RW_W))
+        PANIC("page_table_add: no memory for page table");
+}
+
+/**
+ * kernel_page_tables_init - 检查并清空加载器预先建立的内核页表
+ *
+ * 内核空间的 PDE 769～1022 在启动时全部指向已分配的页表，此后只修改页表中的 PTE，
+ * 从不增删内核 PDE。各进程页目录复制的内核 PDE 因此永远有效，无需同步。
+ * 加载器只清零了页目录，这里经由自映射（这些页表在虚拟地址上连续）把页表清零。
+ */
+static void kernel_page_tables_init(void) {
+    uint32_t vaddr;
+    for (vaddr = KERNEL_HEAP_START; vaddr < 0xffc00000; vaddr += LARGE_PAGE_CNT * PAGE_SIZE) {
+        uint32_t *pde = pde_ptr(vaddr);
+        ASSERT((*pde & PG_P_1) && !(*pde & PG_PS));
+    }
+    memset(pte_ptr(KERNEL_HEAP_START), 0, (KERNEL_PDE_LAST - KERNEL_PDE_FIRST + 1) * PAGE_SIZE);
+}
+
+/**
+ * kernel_pde_copy - 把内核空间的页目录项复制到新的页目录中
+ * @page_dir: 新页目录的虚拟地址
+ *
+ * 以内核页目录为模板复制 PDE 768～1022，所有地址空间因此共享同一组内核页表。
+ * PDE 1023 由调用者设置为指向新页目录自身。
+ */
+void kernel_pde_copy(uint32_t *page_dir) {
+    memcpy(&page_dir[768], (uint32_t *)KERNEL_PAGE_DIR + 768, (1023 - 768) * 4);
+}
+
+/**
+ * frames_alloc - 为内存池的页框描述符数组和位图分配并映射内存。
+ * @m_pool: 需要描述符数组和位图的内存池。
+ * @next_phy_addr: 指向内核物理内存池中下一个可用于元数据的物理地址，分配后向后推进。
+ *
+ * 所用的页框从内核物理内存池的起始处依次划出，在内核虚拟地址池中分配虚拟页面并建立映射。
+ * 位图初始全部置1，只有伙伴系统初始化时释放的页框才会清0，空洞和这些元数据页框因此始终标记为已使用。
+ */
+static void frames_alloc(struct pool *m_pool, uint32_t *next_phy_addr) {
+    uint32_t pg_total = m_pool->pool_size / PAGE_SIZE;
+    uint32_t frames_bytes = pg_total * sizeof(struct page_frame);
+    uint32_t bitmap_bytes = DIV_ROUND_UP(pg_total, 8);
+    uint32_t pg_cnt = DIV_ROUND_UP(frames_bytes + bitmap_bytes, PAGE_SIZE);
+    uint32_t vaddr = (uint32_t)vaddr_get(PF_KERNEL, pg_cnt);
+    ASSERT(vaddr != 0);
+
+    m_pool->frames = (struct page_frame *)vaddr;
+    m_pool->pool_bitmap.bits = (uint8_t *)(vaddr + frames_bytes);
+    m_pool->pool_bitmap.bmap_bytes_len = bitmap_bytes;
+    bool mapped = map_range(vaddr, NULL, *next_phy_addr, pg_cnt, PG_US_U | PG_RW_W);
+    ASSERT(mapped);
+    *next_phy_addr += pg_cnt * PAGE_SIZE;
+    memset(m_pool->frames, 0, frames_bytes);
+    memset(m_pool->pool_bitmap.bits, 0xff, bitmap_bytes);
+}
+
+/**
+ * buddy_init - 初始化内核和用户物理内存池的伙伴系统。
+ *
+ * 先为两个内存池分配页框描述符数组和位图，再把各内存池与可用物理内存区间的交集中未被占用的页框
+ * 按对齐拆分成尽可能大的块，挂入对应阶数的空闲链表。
+ */
+static void buddy_init(void) {
+    put_str("     buddy_init start\n");
+    uint32_t next_phy_addr = kernel_pool.phy_addr_start;
+    frames_alloc(&kernel_pool, &next_phy_addr);
+    frames_alloc(&user_pool, &next_phy_addr);
+    /* 元数据只能从第一个可用区间中连续划出 */
+    ASSERT(next_phy_addr <= mem_regions[0].end && next_phy_addr <= user_pool.phy_addr_start);
+
+    struct pool *pools[2] = {&kernel_pool, &user_pool};
+    int i;
+    for (i = 0; i < 2; i++) {
+        struct pool *m_pool = pools[i];
+        uint32_t pool_start = m_pool->phy_addr_start;
+        uint32_t pool_end = pool_start + m_pool->pool_size;
+        uint8_t order;
+        for (order = 0; order <= BUDDY_MAX_ORDER; order++)
+            list_init(&m_pool->free_area[order]);
+        m_pool->free_pages = 0;
+
+        uint32_t r;
+        for (r = 0; r < mem_region_cnt; r++) {
+            uint32_t start = mem_regions[r].start > pool_start ? mem_regions[r].start : pool_start;
+            uint32_t end = mem_regions[r].end < pool_end ? mem_regions[r].end : pool_end;
+            if (m_pool == &kernel_pool && start < next_phy_addr)
+                start = next_phy_addr;
+            if (start < end)
+                buddy_free_range(m_pool, (start - pool_start) / PAGE_SIZE, (end - start) / PAGE_SIZE);
+        }
+        m_pool->total_pages = m_pool->free_pages;
+        m_pool->used_pages = 0;
+    }
+    put_str("     buddy_init done\n");
+}
+
+/**
+ * kmap - 把物理页框临时映射到内核虚拟地址空间
+ * @pg_phy_addr: 页框的物理地址
+ *
+ * 内核只有低端 4MB 是直接映射的，用户内存池以及未映射的内核页框需要经由这里的窗口访问。
+ * 槽位很少，调用者应尽快 kunmap，且不能在持有映射期间阻塞过久。
+ *
+ * 返回值: 映射得到的内核虚拟地址
+ */
+void *kmap(uint32_t pg_phy_addr) {
+    ASSERT(pg_phy_addr % PAGE_SIZE == 0);
+    enum intr_status old_status = intr_disable();
+    if (kmap_used == 0xffffffff >> (32 - KMAP_SLOTS))
+        PANIC("kmap: no free slot");
+    uint32_t slot = 0;
+    while (kmap_used & (1 << slot))
+        slot++;
+    kmap_used |= 1 << slot;
+    intr_set_status(old_status);
+
+    uint32_t vaddr = kmap_base + slot * PAGE_SIZE;
+    *pte_ptr(vaddr) = pg_phy_addr | PG_G | PG_US_S | PG_RW_W | PG_P_1;
+    return (void *)vaddr;
+}
+
+/**
+ * kunmap - 解除 kmap 建立的临时映射
+ * @vaddr: kmap 返回的虚拟地址
+ *
+ * 清除 PTE 并使该页在 TLB 中失效，槽位之后可以安全地映射其他页框。
+ */
+void kunmap(void *vaddr) {
+    uint32_t slot = ((uint32_t)vaddr - kmap_base) / PAGE_SIZE;
+    ASSERT(slot < KMAP_SLOTS && (kmap_used & (1 << slot)));
+    *pte_ptr((uint32_t)vaddr) = 0;
+    tlb_invalidate((uint32_t)vaddr);
+
+    enum intr_status old_status = intr_disable();
+    kmap_used &= ~(1 << slot);
+    intr_set_status(old_status);
+}
+
+/* kmap_init - 为临时映射窗口保留内核虚拟页面，其页表已在启动时建立 */
+static void kmap_init(void) {
+    kmap_base = (uint32_t)vaddr_get(PF_KERNEL, KMAP_SLOTS);
+    ASSERT(kmap_base != 0);
+    kmap_used = 0;
+}
+
+/**
+ * zero_thread_func - 清零线程，在 CPU 空闲时预先清零空闲页框
+ * @arg: 未使用
+ *
+ * 依次为内核、用户内存池补充已清零页框储备：取出一个页框，经 kmap 临时映射后清零，再放入储备。
+ * 每清零一页就让出 CPU，尽量只占用其他线程不需要的时间。两个储备都已满或内存池已耗尽时阻塞，
+ * 等待分配者把储备取到 ZERO_RESERVE_LOW 以下时唤醒。
+ */
+static void zero_thread_func(void *arg) {
+    struct pool *pools[2] = {&kernel_pool, &user_pool};
+    while (1) {
+        void *page_phy_addr = NULL;
+        struct pool *m_pool = NULL;
+        int i;
+        for (i = 0; i < 2 && page_phy_addr == NULL; i++) {
+            m_pool = pools[i];
+            if (zero_reserve_get(m_pool)->cnt < ZERO_RESERVE_MAX)
+                page_phy_addr = palloc_noswap(m_pool);
+        }
+
+        if (page_phy_addr == NULL) {
+            enum intr_status old_status = intr_disable();
+            zero_thread_idle = true;
+            thread_block(TASK_BLOCKED);
+            intr_set_status(old_status);
+            continue;
+        }
+
+        void *vaddr = kmap((uint32_t)page_phy_addr);
+        memset(vaddr, 0, PAGE_SIZE);
+        kunmap(vaddr);
+
+        struct zero_reserve *reserve = zero_reserve_get(m_pool);
+        enum intr_status old_status = intr_disable();
+        if (reserve->cnt < ZERO_RESERVE_MAX) {
+            reserve->frames[reserve->cnt++] = (uint32_t)page_phy_addr;
+            m_pool->used_pages--;
+            page_phy_addr = NULL;
+        }
+        intr_set_status(old_status);
+        if (page_phy_addr != NULL)
+            pfree((uint32_t)page_phy_addr);
+
+        thread_yield();
+    }
+}
+
+/**
+ * zero_thread_init - 创建以最低优先级运行的清零线程
+ *
+ * 需要在 thread_init 之后调用。
+ */
+void zero_thread_init(void) {
+    zero_thread = thread_start("pg_zero", 1, zero_thread_func, NULL);
+}
+
+/**
+ * zero_reserve_stat - 获取内存池已清零页框储备的统计信息
+ * @pf: 内存池
+ * @cnt: 输出参数，储备中当前的页框数
+ * @hits: 输出参数，命中次数
+ * @misses: 输出参数，未命中次数
+ */
+void zero_reserve_stat(enum pool_flags pf, uint32_t *cnt, uint32_t *hits, uint32_t *misses) {
+    struct zero_reserve *reserve = zero_reserve_get(pf == PF_KERNEL ? &kernel_pool : &user_pool);
+    *cnt = reserve->cnt;
+    *hits = reserve->hits;
+    *misses = reserve->misses;
+}
+
+/**
+ * map_new_pages - 为一段虚拟页面分配物理页框并成批建立映射
+ * @m_pool: 物理页框所属的内存池
+ * @vaddr: 起始虚拟地址，已在虚拟地址池中预留
+ * @pg_cnt: 页面数量
+ * @zero: 是否保证页面内容为0
+ *
+ * 每次从内存池取出至多 MAP_BATCH 个页框，再用一次 map_range() 填写这一批 PTE。
+ * 需要清零时页框优先取自已清零页框储备，只有未清零的页框才同步清零。
+ *
+ * 返回值: 成功映射的页面数。小于 pg_cnt 表示中途分配失败，这一批中未能映射的页框已经归还，
+ *         之前已映射的页面由调用者撤销。
+ */
+static uint32_t map_new_pages(struct pool *m_pool, uint32_t vaddr, uint32_t pg_cnt, bool zero) {
+    uint32_t frames[MAP_BATCH];
+    bool zeroed[MAP_BATCH];
+    uint32_t done = 0;
+
+    while (done < pg_cnt) {
+        uint32_t n = 0, i;
+        while (n < MAP_BATCH && done + n < pg_cnt) {
+            void *page_phy_addr = zero ? palloc_zeroed(m_pool, &zeroed[n]) : palloc(m_pool);
+            if (page_phy_addr == NULL)
+                break;
+            frames[n++] = (uint32_t)page_phy_addr;
+        }
+        if (n == 0)
+            break;
+        if (!map_range(vaddr + done * PAGE_SIZE, frames, 0, n, PG_US_U | PG_RW_W)) {
+            for (i = 0; i < n; i++)
+                pfree(frames[i]);
+            break;
+        }
+        for (i = 0; zero && i < n; i++) {
+            if (!zeroed[i])
+                memset((void *)(vaddr + (done + i) * PAGE_SIZE), 0, PAGE_SIZE);
+        }
+        done += n;
+        /* 没能凑满一批说明内存池已耗尽 */
+        if (n < MAP_BATCH && done < pg_cnt)
+            break;
+    }
+    return done;
+}
+
+/**
+ * pages_unwind - 撤销一次未完成的多页分配
+ * @pf: 内存池标志
+ * @vaddr_start: 已预留的起始虚拟地址
+ * @pg_cnt: 预留的页面总数
+ * @mapped: 从起始地址开始已经映射的页面数
+ *
+ * 已映射的部分连同物理页框由 mfree_page() 归还，其余只预留了虚拟地址的部分直接释放虚拟地址。
+ */
+static void pages_unwind(enum pool_flags pf, uint32_t vaddr_start, uint32_t pg_cnt, uint32_t mapped) {
+    if (mapped > 0)
+        mfree_page(pf, (void *)vaddr_start, mapped);
+    if (mapped < pg_cnt)
+        vaddr_remove(pf, (void *)(vaddr_start + mapped * PAGE_SIZE), pg_cnt - mapped);
+}
+
+/**
+ * malloc_page() - 分配指定数量的页面空间。
+ * @pf: 指示要使用哪个内存池的标志。
+ * @pg_cnt: 要分配的页面数量。
+ *
+ * 此函数分配 'pg_cnt' 个虚拟内存页面，并建立虚拟页面和物理页面之间的映射关系。
+ * 它确保请求不会超过总物理内存大小。
+ * 函数首先分配虚拟页面，然后对于每个虚拟页面，它分配一个相应的物理页面，并设置页表项（PTE）和可能的页目录项（PDE）。
+ * 用户空间中 4MB 对齐、完整覆盖 4MB 的部分直接用 PDE 映射 4MB 大页，减少页表和 TLB 项。
+ * 内核页目录项为所有进程复制共享，因此内核空间只使用 4KB 页面。
+ * 其余页面每次凑齐一批物理页框后交给 map_range() 一次性映射。
+ * 如果在任何时候分配失败，已映射的页面和物理页框连同虚拟地址全部归还，函数返回NULL。
+ *
+ * 上下文: 根据池标志，用于在内核或用户空间中分配内存。
+ * 返回值: 如果成功，则返回已分配虚拟页面的起始地址，否则返回NULL。
+ */
+void *malloc_page(enum pool_flags pf, uint32_t pg_cnt) {
+    /* 确保由 pg_cnt 表示的内存大小不超过总物理内存大小。15MB/4KB = 3840 */
+    ASSERT(pg_cnt > 0 && pg_cnt < 3840);
+    /* 分配虚拟页面，足够大的用户请求让起始地址 4MB 对齐以便使用大页 */
+    bool try_large = pf == PF_USER && pg_cnt >= LARGE_PAGE_CNT;
+    void *vaddr_start = try_large ? vaddr_get_large_aligned(pg_cnt) : vaddr_get(pf, pg_cnt);
+    if (vaddr_start == NULL)
+        return NULL;
+
+    uint32_t vaddr = (uint32_t)vaddr_start;
+    uint32_t cnt = pg_cnt;
+    struct pool *mem_pool = (pf & PF_KERNEL) ? &kernel_pool : &user_pool;
+
+    /* 在相应的池中分配物理页面，即建立虚拟页面和物理页面之间的映射关系，即创建PTE（可能还有PDE） */
+    while (cnt > 0) {
+        /* 4MB 对齐且剩余不少于 4MB 的部分，用一个 4MB 对齐的物理块直接填写 PDE */
+        if (try_large && vaddr % (LARGE_PAGE_CNT * PAGE_SIZE) == 0 && cnt >= LARGE_PAGE_CNT &&
+            !(*pde_ptr(vaddr) & PG_P_1)) {
+            void *large_phy_addr = palloc_contig(mem_pool, LARGE_PAGE_CNT);
+            if (large_phy_addr != NULL) {
+                *pde_ptr(vaddr) = (uint32_t)large_phy_addr | PG_PS | PG_US_U | PG_RW_W | PG_P_1;
+                large_mappings++;
+                running_thread()->rss_pages += LARGE_PAGE_CNT;
+                vaddr += LARGE_PAGE_CNT * PAGE_SIZE;
+                cnt -= LARGE_PAGE_CNT;
+                continue;
+            }
+        }
+        /* 大页的候选区间以 4MB 为单位处理，下一个 4MB 边界之前的页面成批映射 */
+        uint32_t run = cnt;
+        if (try_large && run > LARGE_PAGE_CNT - PTE_IDX(vaddr))
+            run = LARGE_PAGE_CNT - PTE_IDX(vaddr);
+        uint32_t done = map_new_pages(mem_pool, vaddr, run, false);
+        if (done < run) {
+            pages_unwind(pf, (uint32_t)vaddr_start, pg_cnt, (vaddr - (uint32_t)vaddr_start) / PAGE_SIZE + done);
+            return NULL;
+        }
+        vaddr += run * PAGE_SIZE;
+        cnt -= run;
+    }
+    if (pf == PF_KERNEL)
+        MEM_PROFILE_ALLOC(vaddr_start, pg_cnt);
+    return vaddr_start;
+}
+
+/**
+ * get_kernel_pages() - 分配内核页面并将其初始化为零。
+ * @pg_cnt: 要分配的页面数量。
+ *
+ * 此函数在内核空间中分配 'pg_cnt' 个页面，并保证分配的内存已初始化为零。
+ * 页框成批分配并映射，每个页面的物理页框优先取自已清零页框储备，只有储备为空时才同步清零该页。
+ * 分配失败时已映射的页面和虚拟地址全部归还。
+ * 内核虚拟地址池为所有线程共享，因此分配期间持有内核内存池的锁。
+ *
+ * 上下文: 当需要内核空间内存，并且需要将分配的内存初始化为零时使用。
+ * 返回值: 如果成功，则返回已分配和初始化的虚拟页面的起始地址，否则返回NULL。
+ */
+void *get_kernel_pages(uint32_t pg_cnt) {
+    ASSERT(pg_cnt > 0 && pg_cnt < 3840);
+    lock_acquire(&kernel_pool._lock);
+    void *vaddr_start = vaddr_get(PF_KERNEL, pg_cnt);
+    if (vaddr_start == NULL) {
+        lock_release(&kernel_pool._lock);
+        return NULL;
+    }
+
+    uint32_t done = map_new_pages(&kernel_pool, (uint32_t)vaddr_start, pg_cnt, true);
+    if (done < pg_cnt) {
+        pages_unwind(PF_KERNEL, (uint32_t)vaddr_start, pg_cnt, done);
+        vaddr_start = NULL;
+    } else {
+        MEM_PROFILE_ALLOC(vaddr_start, pg_cnt);
+    }
+    lock_release(&kernel_pool._lock);
+    return vaddr_start;
+}
+
+/**
+ * get_user_page - 分配用户空间页面
+ * @pg_cnt: 要分配的4K页面数量
+ * 返回：分配的用户空间内存的虚拟地址
+ *
+ * 在用户空间预留'pg_cnt'数量的4K页面，并返回预留空间的虚拟地址。
+ * 此时只在进程的虚拟内存区域树中登记，物理页框在首次访问时由缺页中断分配并清零，
+ * 因此进程只为实际访问过的页面付出内存。区域树为进程私有，无需加锁。
+ */
+
+void *get_user_page(uint32_t pg_cnt) {
+    return vaddr_get(PF_USER, pg_cnt);
+}
+
+/**
+ * get_a_page - 将虚拟地址映射到物理页面
+ * @pf: 池标志，指示页面是为用户还是内核
+ * @vaddr: 要映射的虚拟地址
+ * 返回：成功时返回虚拟地址‘vaddr’，失败时返回NULL
+ *
+ * 将给定的虚拟地址‘vaddr’映射到指定池‘pf’（用户或内核）的物理页面。
+ * 该函数在内核虚拟地址位图或用户进程的虚拟内存区域树中登记该页面，
+ * 分配一个物理页面，并添加虚拟地址与物理页面之间的映射。如果物理页面分配失败，则返回NULL。
+ * 只有修改共享的内核虚拟地址位图时才需要获取内核内存池的锁。
+ */
+
+void *get_a_page(enum pool_flags pf, uint32_t vaddr) {
+    struct pool *mem_pool = pf & PF_KERNEL ? &kernel_pool : &user_pool;
+    struct task_struct *cur_thread = running_thread();
+    int32_t bit_idx = -1;
+
+    if (cur_thread->pg_dir != NULL && pf == PF_USER) {
+        /* 该页面尚不属于任何区域时为它单独预留一个区域 */
+        if (vma_find(&cur_thread->userprog_vmas, vaddr) == NULL &&
+            !vma_insert(&cur_thread->userprog_vmas, vaddr, vaddr + PAGE_SIZE, 0))
+            return NULL;
+    } else if (cur_thread->pg_dir == NULL && pf == PF_KERNEL) {
+        lock_acquire(&mem_pool->_lock);
+        bit_idx = (vaddr - kernel_vaddr.vaddr_start) / PAGE_SIZE;
+        ASSERT(bit_idx > 0);
+        bitmap_set(&kernel_vaddr.vaddr_bitmap, bit_idx, 1);
+        lock_release(&mem_pool->_lock);
+    } else {
+        PANIC("Unable to establish mapping between pf and vaddr");
+    }
+    void *page_phy_addr = palloc(mem_pool);
+    if (page_phy_addr == NULL)
+        return NULL;
+    page_table_add((void *)vaddr, page_phy_addr);
+    return (void *)vaddr;
+}
+
+/**
+ * addr_v2p - 将虚拟地址转换为物理地址
+ * @vaddr: 要转换的虚拟地址
+ * 返回：相应的物理地址
+ *
+ * 该函数使用页表条目将给定的虚拟地址转换为其对应的物理地址。
+ * 若虚拟地址位于 4MB 大页中，物理地址由 PDE 的高10位与虚拟地址的低22位组成；
+ * 否则定位给定虚拟地址的页表条目，结合页表条目中物理页面帧地址的高20位与原始虚拟地址的低12位。
+ */
+uint32_t addr_v2p(uint32_t vaddr) {
+    uint32_t *pde = pde_ptr(vaddr);
+    if (*pde & PG_PS)
+        return ((*pde & 0xffc00000) + (vaddr & 0x003fffff));
+    uint32_t *pte_phy_addr = pte_ptr(vaddr);
     return ((*pte_phy_addr & 0xfffff000) + (vaddr & 0x00000fff));
 }
+
+/* frame_of - 获取物理地址 pg_phy_addr 处页框的描述符 */
+static struct page_frame *frame_of(struct pool *m_pool, uint32_t pg_phy_addr) {
+    return &m_pool->frames[(pg_phy_addr - m_pool->phy_addr_start) / PAGE_SIZE];
+}
+
+/**
+ * frame_ref_get - 为已分配的页框增加一个引用
+ * @pg_phy_addr: 页框的物理地址
+ *
+ * 同一页框映射到多个地址空间时，每多一处映射调用一次。之后每次 pfree 只释放一个引用，
+ * 最后一个持有者调用 pfree 时页框才归还给内存池。
+ */
+void frame_ref_get(uint32_t pg_phy_addr) {
+    struct pool *mem_pool = pg_phy_addr >= user_pool.phy_addr_start ? &user_pool : &kernel_pool;
+    enum intr_status old_status = intr_disable();
+    struct page_frame *frame = frame_of(mem_pool, pg_phy_addr);
+    ASSERT(frame->ref_cnt < 0xffff);
+    frame->ref_cnt++;
+    intr_set_status(old_status);
+}
+
+/* frame_ref_cnt - 页框除第一个持有者之外的引用数，为 0 表示页框只有一个持有者 */
+uint16_t frame_ref_cnt(uint32_t pg_phy_addr) {
+    struct pool *mem_pool = pg_phy_addr >= user_pool.phy_addr_start ? &user_pool : &kernel_pool;
+    return frame_of(mem_pool, pg_phy_addr)->ref_cnt;
+}
+
+/**
+ * pfree - 将物理页框归还给所属的内存池
+ * @pg_phy_addr: 页框的物理地址
+ *
+ * 页框还有其他引用时只减少引用数。否则页框先放回当前任务的页框弹匣，
+ * 弹匣已满时才把 MAG_BATCH 个页框批量归还给伙伴系统。
+ */
+void pfree(uint32_t pg_phy_addr) {
+    struct pool *mem_pool = pg_phy_addr >= user_pool.phy_addr_start ? &user_pool : &kernel_pool;
+    ASSERT(pg_phy_addr % PAGE_SIZE == 0 && pg_phy_addr >= kernel_pool.phy_addr_start);
+
+    /* 绝大多数页框没有共享，先不关中断检查一次 */
+    struct page_frame *frame = frame_of(mem_pool, pg_phy_addr);
+    if (frame->ref_cnt > 0) {
+        enum intr_status old_status = intr_disable();
+        if (frame->ref_cnt > 0) {
+            frame->ref_cnt--;
+            intr_set_status(old_status);
+            return;
+        }
+        intr_set_status(old_status);
+    }
+    pool_used_add(mem_pool, -1);
+
+    struct page_magazine *mag = magazine_get(mem_pool);
+    if (mag == NULL) {
+        lock_acquire(&mem_pool->_lock);
+        buddy_free_block(mem_pool, (pg_phy_addr - mem_pool->phy_addr_start) / PAGE_SIZE, 0);
+        lock_release(&mem_pool->_lock);
+        return;
+    }
+    if (mag->cnt == MAG_SIZE)
+        magazine_drain(mem_pool, mag);
+    mag->frames[mag->cnt++] = pg_phy_addr;
+}
+
+/* tlb_batch_add - 记录一个需要失效的虚拟页面 */
+static void tlb_batch_add(struct tlb_batch *batch, uint32_t vaddr) {
+    if (batch->cnt < TLB_FLUSH_THRESHOLD)
+        batch->vaddrs[batch->cnt] = vaddr;
+    batch->cnt++;
+    if (vaddr >= 0xc0000000)
+        batch->global = true;
+}
+
+/**
+ * tlb_batch_flush - 使批次中收集的虚拟页面在 TLB 中失效
+ * @batch: 待刷新的批次
+ *
+ * 页面数不超过 TLB_FLUSH_THRESHOLD 时逐页执行 invlpg，否则整体刷新一次 TLB，
+ * 用一次整体刷新代替大量的单页失效。只涉及用户页面时重新加载 CR3 即可，涉及内核全局页时需要翻转 CR4.PGE。
+ */
+static void tlb_batch_flush(struct tlb_batch *batch) {
+    if (batch->cnt > TLB_FLUSH_THRESHOLD && !batch->global) {
+        uint32_t cr3;
+        asm volatile("movl %%cr3, %0" : "=r"(cr3));
+        asm volatile("movl %0, %%cr3" ::"r"(cr3) : "memory");
+    } else if (batch->cnt > TLB_FLUSH_THRESHOLD) {
+        /* 重新加载 CR3 不会清除内核的全局页，先关闭再打开 CR4.PGE 才能刷新包括全局页在内的整个 TLB */
+        uint32_t cr4;
+        asm volatile("movl %%cr4, %0" : "=r"(cr4));
+        asm volatile("movl %0, %%cr4" ::"r"(cr4 & ~CR4_PGE) : "memory");
+        asm volatile("movl %0, %%cr4" ::"r"(cr4) : "memory");
+    } else {
+        uint32_t i;
+        for (i = 0; i < batch->cnt; i++)
+            tlb_invalidate(batch->vaddrs[i]);
+    }
+    batch->cnt = 0;
+    batch->global = false;
+}
+
+/**
+ * page_table_pte_remove - 清除虚拟地址 vaddr 对应 PTE 的 P 位
+ * @vaddr: 虚拟地址
+ * @batch: 收集待失效页面的批次，TLB 在整个操作结束后统一刷新
+ */
+static void page_table_pte_remove(uint32_t vaddr, struct tlb_batch *batch) {
+    uint32_t *pte = pte_ptr(vaddr);
+    *pte &= ~PG_P_1;
+    tlb_batch_add(batch, vaddr);
+    if (vaddr < 0xc0000000)
+        running_thread()->rss_pages--;
+}
+
+/**
+ * large_page_split - 把一个 4MB 大页映射拆分为 1024 个 4KB 页面映射
+ * @vaddr: 大页范围内的虚拟地址
+ *
+ * 为该区域分配一个页表，逐项映射到大页原来的物理页框，属性保持不变。用于只释放大页的一部分时。
+ */
+static void large_page_split(uint32_t vaddr) {
+    uint32_t *pde = pde_ptr(vaddr);
+    uint32_t large_phy_addr = *pde & 0xffc00000;
+    uint32_t attr = *pde & (PG_US_U | PG_RW_W | PG_P_1);
+    uint32_t pt_phy_addr = (uint32_t)palloc(&kernel_pool);
+    ASSERT(pt_phy_addr != 0);
+    pt_pages_add(1);
+    MEM_PROFILE_ALLOC(pt_phy_addr + 1, 1);
+
+    uint32_t *pt = (uint32_t *)((uint32_t)pte_ptr(vaddr) & 0xfffff000);
+    *pde = pt_phy_addr | PG_US_U | PG_RW_W | PG_P_1;
+    /* 大页本身以及经由自映射访问的页表地址都可能留在 TLB 中 */
+    tlb_invalidate(vaddr);
+    tlb_invalidate((uint32_t)pt);
+
+    uint32_t i;
+    for (i = 0; i < LARGE_PAGE_CNT; i++)
+        pt[i] = (large_phy_addr + i * PAGE_SIZE) | attr;
+    small_mappings += LARGE_PAGE_CNT;
+}
+
+/**
+ * mfree_page - 释放以虚拟地址 _vaddr 起始的 pg_cnt 个页面
+ * @pf: 页面所属的池
+ * @_vaddr: 起始虚拟地址，须页对齐
+ * @pg_cnt: 页面数量
+ *
+ * 逐页清除 PTE 并把页框归还给内存池，所有页面处理完后统一刷新 TLB，最后释放虚拟地址。
+ * 完整覆盖的 4MB 大页整体归还，只释放一部分的大页先拆分为 4KB 页面。
+ * 在 TLB 刷新之前页框可能已被别的任务重新分配，但旧映射所在的虚拟地址直到刷新之后才释放，
+ * 单处理器上不会有人再通过它访问这些页框。
+ */
+void mfree_page(enum pool_flags pf, void *_vaddr, uint32_t pg_cnt) {
+    uint32_t vaddr = (uint32_t)_vaddr, cnt = 0;
+    ASSERT(pg_cnt >= 1 && vaddr % PAGE_SIZE == 0);
+    struct tlb_batch batch;
+    batch.cnt = 0;
+    batch.global = false;
+
+    while (cnt < pg_cnt) {
+        uint32_t *pde = pde_ptr(vaddr);
+        if (*pde & PG_PS) {
+            ASSERT(pf == PF_USER);
+            if (vaddr % (LARGE_PAGE_CNT * PAGE_SIZE) == 0 && pg_cnt - cnt >= LARGE_PAGE_CNT) {
+                pfree_contig(&user_pool, (void *)(*pde & 0xffc00000), LARGE_PAGE_CNT);
+                running_thread()->rss_pages -= LARGE_PAGE_CNT;
+                *pde = 0;
+                tlb_batch_add(&batch, vaddr);
+                vaddr += LARGE_PAGE_CNT * PAGE_SIZE;
+                cnt += LARGE_PAGE_CNT;
+                continue;
+            }
+            large_page_split(vaddr);
+        }
+
+        /* 按需分配的用户页面可能从未被访问过，此时只需释放虚拟地址；已换出的页面还要释放交换槽位 */
+        if (pf == PF_USER && (!(*pde & PG_P_1) || !(*pte_ptr(vaddr) & PG_P_1))) {
+            if ((*pde & PG_P_1) && (*pte_ptr(vaddr) & PG_SWAP)) {
+                swap_slot_free(*pte_ptr(vaddr));
+                *pte_ptr(vaddr) = 0;
+            }
+            vaddr += PAGE_SIZE;
+            cnt++;
+            continue;
+        }
+        uint32_t pg_phy_addr = addr_v2p(vaddr);
+        ASSERT(*pte_ptr(vaddr) & PG_P_1);
+        if (pf == PF_USER) {
+            ASSERT(pg_phy_addr >= user_pool.phy_addr_start);
+        } else {
+            ASSERT(pg_phy_addr >= kernel_pool.phy_addr_start && pg_phy_addr < user_pool.phy_addr_start);
+        }
+        pfree(pg_phy_addr);
+        page_table_pte_remove(vaddr, &batch);
+        vaddr += PAGE_SIZE;
+        cnt++;
+    }
+    tlb_batch_flush(&batch);
+    if (pf == PF_KERNEL)
+        MEM_PROFILE_FREE(_vaddr, pg_cnt);
+    vaddr_remove(pf, _vaddr, pg_cnt);
+}
+
+/**
+ * cow_release - 释放 cow_share 为子进程建立的用户页表
+ * @child_pg_dir: 子进程页目录的虚拟地址
+ *
+ * 页表中每个存在的页面释放一个引用，然后归还页表本身。只在 fork 失败时使用。
+ */
+static void cow_release(uint32_t *child_pg_dir) {
+    uint32_t pde_idx;
+    for (pde_idx = 0; pde_idx < PDE_IDX(0xc0000000); pde_idx++) {
+        if (!(child_pg_dir[pde_idx] & PG_P_1))
+            continue;
+        uint32_t pt_phy_addr = child_pg_dir[pde_idx] & 0xfffff000;
+        uint32_t *pt = kmap(pt_phy_addr);
+        uint32_t i;
+        for (i = 0; i < LARGE_PAGE_CNT; i++) {
+            if (pt[i] & PG_P_1)
+                pfree(pt[i] & 0xfffff000);
+        }
+        kunmap(pt);
+        pfree(pt_phy_addr);
+        pt_pages_add(-1);
+        MEM_PROFILE_FREE(pt_phy_addr + 1, 1);
+        child_pg_dir[pde_idx] = 0;
+    }
+}
+
+/**
+ * cow_share - 让子进程的页目录与当前进程共享全部用户页框
+ * @child_pg_dir: 子进程页目录的虚拟地址，内核部分已由 create_page_dir 填好
+ *
+ * 当前进程每个存在的用户页表都为子进程复制一份，子进程的页表经由临时映射窗口填写。
+ * 可写的页面在父子两边都去掉 RW 位并标记 PG_COW，每个页框增加一个引用，
+ * 哪一方先写入，就由缺页异常为它复制一份私有页框。共享内存页面保持可写。
+ * 4MB 大页先拆分为 4KB 页面再共享，已换出的页面先从交换区读回。耗时只与页表的数量成正比，与驻留内存的多少无关。
+ *
+ * 返回值: 成功返回 true；为子进程分配页表或读回换出的页面失败时释放已建立的页表并返回 false。
+ */
+bool cow_share(uint32_t *child_pg_dir) {
+    struct tlb_batch batch;
+    batch.cnt = 0;
+    batch.global = false;
+
+    uint32_t pde_idx;
+    for (pde_idx = 0; pde_idx < PDE_IDX(0xc0000000); pde_idx++) {
+        uint32_t vaddr = pde_idx << 22;
+        uint32_t *pde = pde_ptr(vaddr);
+        if (!(*pde & PG_P_1))
+            continue;
+        if (*pde & PG_PS)
+            large_page_split(vaddr);
+
+        uint32_t child_pt_phy_addr = (uint32_t)palloc(&kernel_pool);
+        if (child_pt_phy_addr == 0) {
+            tlb_batch_flush(&batch);
+            cow_release(child_pg_dir);
+            return false;
+        }
+        pt_pages_add(1);
+        MEM_PROFILE_ALLOC(child_pt_phy_addr + 1, 1);
+
+        uint32_t *pt = pte_ptr(vaddr);
+        uint32_t *child_pt = kmap(child_pt_phy_addr);
+        uint32_t i;
+        for (i = 0; i < LARGE_PAGE_CNT; i++) {
+            /* 已换出的页面先读回再共享，内存不足时撤销已建立的一切 */
+            if (!(pt[i] & PG_P_1) && (pt[i] & PG_SWAP) && !swap_in(vaddr + i * PAGE_SIZE)) {
+                memset(&child_pt[i], 0, (LARGE_PAGE_CNT - i) * sizeof(uint32_t));
+                kunmap(child_pt);
+                child_pg_dir[pde_idx] = child_pt_phy_addr | PG_US_U | PG_RW_W | PG_P_1;
+                tlb_batch_flush(&batch);
+                cow_release(child_pg_dir);
+                return false;
+            }
+            uint32_t pte = pt[i];
+            if (!(pte & PG_P_1)) {
+                child_pt[i] = 0;
+                continue;
+            }
+            if ((pte & PG_RW_W) && !(pte & PG_SHARED)) {
+                pte = (pte & ~PG_RW_W) | PG_COW;
+                pt[i] = pte;
+                tlb_batch_add(&batch, vaddr + i * PAGE_SIZE);
+            }
+            frame_ref_get(pte & 0xfffff000);
+            child_pt[i] = pte;
+        }
+        kunmap(child_pt);
+        child_pg_dir[pde_idx] = child_pt_phy_addr | PG_US_U | PG_RW_W | PG_P_1;
+    }
+    /* 父进程原先可写的页面改为只读，旧的 TLB 项必须失效 */
+    tlb_batch_flush(&batch);
+    return true;
+}
+
+/**
+ * cow_fault - 处理对写时复制页面的写入
+ * @vaddr: 被写入页面的虚拟地址
+ *
+ * 页框只剩当前进程一个引用时直接恢复可写；否则经由临时映射窗口复制一份私有页框，
+ * 再释放对原页框的引用。
+ *
+ * 返回值: 已处理返回 true；vaddr 不是写时复制页面或内存不足时返回 false。
+ */
+static bool cow_fault(uint32_t vaddr) {
+    uint32_t *pde = pde_ptr(vaddr);
+    if (!(*pde & PG_P_1) || (*pde & PG_PS))
+        return false;
+    uint32_t *pte = pte_ptr(vaddr);
+    if (!(*pte & PG_P_1) || !(*pte & PG_COW))
+        return false;
+
+    uint32_t old_phy_addr = *pte & 0xfffff000;
+    uint32_t attr = (*pte & 0xfff & ~PG_COW) | PG_RW_W;
+    if (frame_of(&user_pool, old_phy_addr)->ref_cnt == 0) {
+        *pte = old_phy_addr | attr;
+        tlb_invalidate(vaddr);
+        return true;
+    }
+
+    void *new_phy_addr = palloc(&user_pool);
+    if (new_phy_addr == NULL)
+        return false;
+    void *copy = kmap((uint32_t)new_phy_addr);
+    memcpy(copy, (void *)vaddr, PAGE_SIZE);
+    kunmap(copy);
+    *pte = (uint32_t)new_phy_addr | attr;
+    tlb_invalidate(vaddr);
+    pfree(old_phy_addr);
+    return true;
+}
+
+/**
+ * mapping_stat - 获取已建立的大页与普通页面映射的累计数量
+ * @large_cnt: 输出参数，4MB 大页映射数
+ * @small_cnt: 输出参数，4KB 页面映射数
+ */
+void mapping_stat(uint32_t *large_cnt, uint32_t *small_cnt) {
+    *large_cnt = large_mappings;
+    *small_cnt = small_mappings;
+}
+
+/**
+ * sys_memstat - 填写内存池和当前进程的内存使用情况
+ * @stat: 用户提供的缓冲区
+ *
+ * 各项计数都在分配与释放路径上增量维护，这里只是读取。内核线程没有用户地址空间，进程相关的两项为0。
+ */
+void sys_memstat(struct mem_stat *stat) {
+    struct task_struct *cur_thread = running_thread();
+    stat->kernel_used = kernel_pool.used_pages;
+    stat->kernel_free = kernel_pool.total_pages - kernel_pool.used_pages;
+    stat->user_used = user_pool.used_pages;
+    stat->user_free = user_pool.total_pages - user_pool.used_pages;
+    stat->pt_pages = pt_pages;
+    stat->rss_pages = cur_thread->rss_pages;
+    stat->reserved_pages = cur_thread->pg_dir != NULL ? cur_thread->userprog_vmas.reserved_pages : 0;
+    stat->swap_pages = swap_used();
+    zram_stat(stat);
+}
+
+/**
+ * block_desc_init - 初始化内存块描述符数组
+ * @desc_array: 含 MB_DESC_CNT 个元素的内存块描述符数组
+ *
+ * 依次设置 16、32、64 ... 1024 字节共 MB_DESC_CNT 种规格，并计算每种规格一个 arena 可容纳的块数。
+ */
+void block_desc_init(struct mem_block_desc *desc_array) {
+    uint16_t desc_idx, block_size = 16;
+
+    for (desc_idx = 0; desc_idx < MB_DESC_CNT; desc_idx++) {
+        desc_array[desc_idx].block_size = block_size;
+        desc_array[desc_idx].blocks_per_arena = (PAGE_SIZE - sizeof(struct arena)) / block_size;
+        list_init(&desc_array[desc_idx].free_list);
+        block_size *= 2;
+    }
+}
+
+/**
+ * arena_desc - 获取 arena 所属的内存块描述符
+ * @a: 小内存分配的 arena
+ *
+ * 用户进程的 arena 记录的是创建它的进程 PCB 中描述符的地址。fork 出的子进程继承了这些 arena，
+ * 所有 PCB 都按页对齐且布局相同，按页内偏移换算成当前进程 PCB 中的同一个描述符。
+ */
+static struct mem_block_desc *arena_desc(struct arena *a) {
+    struct task_struct *cur_thread = running_thread();
+    if (cur_thread->pg_dir == NULL)
+        return a->desc;
+    return (struct mem_block_desc *)((uint32_t)cur_thread + ((uint32_t)a->desc & 0xfff));
+}
+
+/* arena2block - 返回 arena 中第 idx 个内存块的地址 */
+static struct mem_block *arena2block(struct arena *a, uint32_t idx) {
+    return (struct mem_block *)((uint32_t)a + sizeof(struct arena) + idx * arena_desc(a)->block_size);
+}
+
+/* block2arena - 返回内存块 b 所在的 arena 地址 */
+static struct arena *block2arena(struct mem_block *b) {
+    return (struct arena *)((uint32_t)b & 0xfffff000);
+}
+
+/**
+ * block_desc_fixup - 让继承来的空闲链表首尾指回当前进程自己的表头、表尾
+ * @descs: 当前进程的内存块描述符数组
+ *
+ * fork 复制了 PCB 中的表头，但空闲内存块位于用户内存中，首尾两块仍指向父进程 PCB 中的表头、表尾。
+ * 子进程第一次分配或释放时修正，写入发生在子进程自己的地址空间中，由写时复制得到私有页面。
+ */
+static void block_desc_fixup(struct mem_block_desc *descs) {
+    uint8_t desc_idx;
+    for (desc_idx = 0; desc_idx < MB_DESC_CNT; desc_idx++) {
+        struct list *plist = &descs[desc_idx].free_list;
+        if (!list_empty(plist) && plist->head.next->prev != &plist->head) {
+            plist->head.next->prev = &plist->head;
+            plist->tail.prev->next = &plist->tail;
+        }
+    }
+}
+
+/**
+ * sys_malloc - 在堆中申请 size 字节内存
+ * @size: 要申请的字节数
+ *
+ * 内核线程使用 kernel_pool 和 k_block_descs，用户进程使用 user_pool 和自己 PCB 中的 u_block_desc。
+ * 不超过 1024 字节的请求向上取整到对应规格，从该规格的空闲链表中弹出一块；链表为空时才申请
+ * 一个新的 arena 页面并切分成块。超过 1024 字节的请求直接分配所需页框。
+ *
+ * 返回值: 成功时返回内存块的虚拟地址（已清零），失败时返回 NULL。
+ */
+void *sys_malloc(uint32_t size) {
+    enum pool_flags PF;
+    struct pool *mem_pool;
+    uint32_t pool_size;
+    struct mem_block_desc *descs;
+    struct task_struct *cur_thread = running_thread();
+
+    /* 判断用哪个内存池 */
+    if (cur_thread->pg_dir == NULL) {
+        PF = PF_KERNEL;
+        pool_size = kernel_pool.pool_size;
+        mem_pool = &kernel_pool;
+        descs = k_block_descs;
+    } else {
+        PF = PF_USER;
+        pool_size = user_pool.pool_size;
+        mem_pool = &user_pool;
+        descs = cur_thread->u_block_desc;
+    }
+
+    /* 若申请的内存不在内存池容量范围内则直接返回 NULL */
+    if (!(size > 0 && size < pool_size))
+        return NULL;
+
+    struct arena *a;
+    struct mem_block *b;
+    lock_acquire(&mem_pool->_lock);
+    if (PF == PF_USER)
+        block_desc_fixup(descs);
+
+    if (size > descs[MB_DESC_CNT - 1].block_size) {
+        /* 超过最大内存块 1024 字节，就直接分配页框 */
+        uint32_t page_cnt = DIV_ROUND_UP(size + sizeof(struct arena), PAGE_SIZE);
+        if (PF == PF_KERNEL) {
+            a = get_kernel_pages(page_cnt);
+        } else if (page_cnt >= LARGE_PAGE_CNT) {
+            /* 至少 4MB 的用户请求立即分配，以便用 4MB 大页映射 */
+            a = malloc_page(PF_USER, page_cnt);
+            if (a != NULL)
+                memset(a, 0, page_cnt * PAGE_SIZE);
+        } else {
+            a = get_user_page(page_cnt);
+        }
+        if (a == NULL) {
+            lock_release(&mem_pool->_lock);
+            return NULL;
+        }
+
+        a->desc = NULL;
+        a->cnt = page_cnt;
+        a->large = true;
+        lock_release(&mem_pool->_lock);
+        return (void *)(a + 1);
+    }
+
+    /* 小于等于 1024 字节，在各种规格的 mem_block_desc 中寻找合适的块 */
+    uint8_t desc_idx;
+    for (desc_idx = 0; desc_idx < MB_DESC_CNT; desc_idx++) {
+        if (size <= descs[desc_idx].block_size)
+            break;
+    }
+
+    /* 若该规格已无可用块，就创建新的 arena 提供块 */
+    if (list_empty(&descs[desc_idx].free_list)) {
+        a = PF == PF_KERNEL ? get_kernel_pages(1) : get_user_page(1);
+        if (a == NULL) {
+            lock_release(&mem_pool->_lock);
+            return NULL;
+        }
+
+        a->desc = &descs[desc_idx];
+        a->large = false;
+        a->cnt = descs[desc_idx].blocks_per_arena;
+
+        /* 将 arena 拆分成内存块并添加到空闲链表，期间关中断避免链表被打断 */
+        uint32_t block_idx;
+        enum intr_status old_status = intr_disable();
+        for (block_idx = 0; block_idx < descs[desc_idx].blocks_per_arena; block_idx++) {
+            b = arena2block(a, block_idx);
+            ASSERT(!list_elem_find(&a->desc->free_list, &b->free_elem));
+            list_append(&a->desc->free_list, &b->free_elem);
+        }
+        intr_set_status(old_status);
+    }
+
+    /* 开始分配内存块 */
+    b = elem2entry(struct mem_block, free_elem, list_pop(&(descs[desc_idx].free_list)));
+    memset(b, 0, descs[desc_idx].block_size);
+
+    a = block2arena(b);
+    a->cnt--;
+    lock_release(&mem_pool->_lock);
+    return (void *)b;
+}
+
+/**
+ * sys_free - 回收 sys_malloc 分配的内存
+ * @ptr: sys_malloc 返回的地址
+ *
+ * 大内存分配直接释放其占用的页面。小内存块归还到所属规格的空闲链表，
+ * 若归还后整个 arena 都空闲，则把其中的内存块从链表中摘除并释放 arena 页面。
+ */
+void sys_free(void *ptr) {
+    ASSERT(ptr != NULL);
+    if (ptr == NULL)
+        return;
+
+    enum pool_flags PF;
+    struct pool *mem_pool;
+    if (running_thread()->pg_dir == NULL) {
+        ASSERT((uint32_t)ptr >= KERNEL_HEAP_START);
+        PF = PF_KERNEL;
+        mem_pool = &kernel_pool;
+    } else {
+        PF = PF_USER;
+        mem_pool = &user_pool;
+    }
+    lock_acquire(&mem_pool->_lock);
+
+    struct mem_block *b = ptr;
+    struct arena *a = block2arena(b);
+    ASSERT(a->large == 0 || a->large == 1);
+
+    if (a->desc == NULL && a->large == true) {
+        mfree_page(PF, a, a->cnt);
+    } else {
+        struct mem_block_desc *desc = arena_desc(a);
+        if (PF == PF_USER)
+            block_desc_fixup(running_thread()->u_block_desc);
+        list_append(&desc->free_list, &b->free_elem);
+        a->cnt++;
+        ASSERT(a->cnt <= desc->blocks_per_arena);
+
+        /* 此 arena 中的内存块都是空闲的，释放整个 arena */
+        if (a->cnt == desc->blocks_per_arena) {
+            uint32_t block_idx;
+            for (block_idx = 0; block_idx < desc->blocks_per_arena; block_idx++) {
+                struct mem_block *block = arena2block(a, block_idx);
+                list_remove(&block->free_elem);
+            }
+            mfree_page(PF, a, 1);
+        }
+    }
+    lock_release(&mem_pool->_lock);
+}
+
+/**
+ * user_stack_esp - 获取当前用户进程进入内核时保存的用户态栈指针
+ *
+ * 用户进程通过中断或系统调用进入内核时，intr_stack 位于 PCB 页面的最高处。
+ */
+static uint32_t user_stack_esp(void) {
+    struct intr_stack *user_frame =
+        (struct intr_stack *)((uint32_t)running_thread() + PAGE_SIZE - sizeof(struct intr_stack));
+    return (uint32_t)user_frame->esp;
+}
+
+/**
+ * user_vaddr_reserved - 判断缺页地址是否属于当前进程已预留的虚拟地址
+ * @vaddr: 页对齐的虚拟地址
+ * @esp: 发生缺页时的用户态栈指针
+ *
+ * 落在进程某个虚拟内存区域中的页面都是预留的。对于用户栈区域，只有不低于 esp - 32 的地址
+ * （push/pusha 可能访问 esp 以下 32 字节）才视为栈的向下增长。
+ */
+static bool user_vaddr_reserved(uint32_t vaddr, uint32_t esp) {
+    struct vm_area *vma = vma_find(&running_thread()->userprog_vmas, vaddr);
+
+    if (vma == NULL)
+        return false;
+    if (vma->flags & VMA_STACK)
+        return vaddr + PAGE_SIZE > esp - 32;
+    return true;
+}
+
+/**
+ * intr_page_fault - 缺页异常（0x0e）处理函数
+ * @vec_nr: 中断向量号，它在栈上的位置正是 intr_stack 的起始处
+ *
+ * 从 CR2 读出缺页地址。已换出的用户页面从交换区读回。若是用户进程访问自己已预留但尚未建立映射的页面，或者是用户栈向下增长，
+ * 就分配一个物理页框（优先取已清零的页框）、建立映射并清零，返回后 CPU 重新执行引发缺页的指令。
+ * 其余情况（内核地址缺页、写保护违例、访问未预留的地址）均视为错误。
+ */
+static void intr_page_fault(uint32_t vec_nr) {
+    struct intr_stack *frame = (struct intr_stack *)&vec_nr;
+    struct task_struct *cur_thread = running_thread();
+    uint32_t fault_vaddr;
+    asm volatile("movl %%cr2, %0" : "=r"(fault_vaddr));
+
+    /* 错误码第 0 位为 0 表示页面不存在，第 2 位为 1 表示缺页发生在用户态 */
+    bool not_present = !(frame->error_code & 0x1);
+    bool from_user = frame->error_code & 0x4;
+    uint32_t vaddr = fault_vaddr & 0xfffff000;
+
+    /* 错误码第 1 位为 1 表示写入。CR0.WP 置1后，内核写入用户的只读页面同样会到这里 */
+    if (!not_present && (frame->error_code & 0x2) && cur_thread->pg_dir != NULL &&
+        vaddr < 0xc0000000 && cow_fault(vaddr))
+        return;
+
+    if (not_present && cur_thread->pg_dir != NULL && vaddr >= USER_VADDR_START &&
+        vaddr < 0xc0000000) {
+        if (swap_in(vaddr))
+            return;
+        uint32_t esp = from_user ? (uint32_t)frame->esp : user_stack_esp();
+        if (user_vaddr_reserved(vaddr, esp)) {
+            bool zeroed;
+            void *page_phy_addr = palloc_zeroed(&user_pool, &zeroed);
+            if (page_phy_addr != NULL) {
+                page_table_add((void *)vaddr, page_phy_addr);
+                if (!zeroed)
+                    memset((void *)vaddr, 0, PAGE_SIZE);
+                return;
+            }
+        }
+    }
+
+    put_str("\npage fault addr is ");
+    put_int(fault_vaddr);
+    put_str(", error code is ");
+    put_int(frame->error_code);
+    put_str(", eip is ");
+    put_int((uint32_t)frame->eip);
+    PANIC("unhandled page fault");
+}
+
+/*
+ * mem_init() - 内存管理初始化的入口点。
+ *
+ * 此函数标记了内存初始化的开始。首先打印一条消息表示内存初始化的开始。
+ * 然后读取总内存大小，并使用此大小初始化内存池。
+ * 最后，初始化内存块描述符数组，这对于 malloc 函数是至关重要的，并打印完成消息。
+ *
+ * 上下文: 此函数对于设置内存管理系统至关重要。它初始化内存池并准备用于动态内存分配的内存块描述符。
+ * 返回值: 此函数不返回值。
+ */
+void mem_init() {
+    put_str("  mem_init start\n");
+    uint32_t mem_bytes_total = (*(uint32_t *)(0xb00));
+    kernel_page_tables_init();
+    mem_pool_init(mem_bytes_total);
+    buddy_init();
+    kmap_init();
+    vma_init();
+    block_desc_init(k_block_descs);
+    register_handler(0x0e, intr_page_fault);
+    put_str("  mem_init done\n");
+}
@@ -10,9 +10,24 @@
 #define PG_RW_W 2 //读写、执行
 #define PG_US_S 0 //系统级
 #define PG_US_U 4 //用户级
+#define PG_A    0x20 //访问位，处理器访问页面时置1，换出时据此挑选不常用的页面
+#define PG_PS   0x80 //页目录项直接映射4MB大页
+#define PG_G    0x100 //全局页，切换CR3时保留在TLB中，只用于内核空间
+#define PG_SHARED 0x200 //软件可用位：共享内存页面，fork 之后父子进程仍可写共享
+#define PG_COW    0x400 //软件可用位：写时复制页面，写入时在缺页异常中复制
+#define PG_SWAP   0x800 //软件可用位：P 为0时表示页面已换出，高20位为换出项
+
+/* 内核线程共用的页目录的物理地址 */
+#define KERNEL_PAGE_DIR_PHY 0x100000
 
 #define MB_DESC_CNT 7
 
+/* 页框弹匣的容量，以及与共享内存池之间一次补充或归还的页框数 */
+#define MAG_SIZE  32
+#define MAG_BATCH 16
+#define MAG_KERNEL 0
+#define MAG_USER   1
+
 enum pool_flags { PF_KERNEL = 1, PF_USER = 2 };
 
 /*
@@ -30,11 +45,72 @@ struct virtual_addr {
     uint32_t vaddr_start;
 };
 
+/**
+ * struct mem_block - 内存块，即 arena 中被切分出的最小分配单元。
+ * @free_elem: 空闲时挂在所属描述符 free_list 上的节点。
+ */
+struct mem_block {
+    struct list_elem free_elem;
+};
+
+/**
+ * struct mem_block_desc - 内存块描述符，描述一种规格的内存块。
+ * @block_size: 该规格内存块的大小（字节）。
+ * @blocks_per_arena: 一个 arena 页面能容纳的内存块数量。
+ * @free_list: 当前可用的空闲内存块链表。
+ *
+ * 共有 MB_DESC_CNT 种规格，从 16 字节到 1024 字节依次翻倍。
+ */
+struct mem_block_desc {
+    uint32_t block_size;
+    uint32_t blocks_per_arena;
+    struct list free_list;
+};
+
+/**
+ * struct page_magazine - 任务私有的页框缓存。
+ * @cnt: 当前缓存的页框数量。
+ * @frames: 缓存页框的物理地址，按栈的方式使用。
+ *
+ * 只有所属任务自己会访问，因此存取时无需加锁。为空时从共享内存池一次补充 MAG_BATCH 个页框，
+ * 满时一次归还 MAG_BATCH 个，只有这两种情况才需要获取内存池的锁。
+ */
+struct page_magazine {
+    uint32_t cnt;
+    uint32_t frames[MAG_SIZE];
+};
+
+struct mem_stat;
 
 extern struct pool kernel_pool, user_pool;
 void mem_init();
 void *get_kernel_pages(uint32_t pg_cnt);
 void *get_a_page(enum pool_flags pf, uint32_t vaddr);
 uint32_t addr_v2p(uint32_t vaddr);
+uint32_t *pte_ptr(uint32_t vaddr);
+uint32_t *pde_ptr(uint32_t vaddr);
+bool map_range(uint32_t vaddr, const uint32_t *phy_addrs, uint32_t phy_start, uint32_t pg_cnt,
+               uint32_t flags);
+void kernel_pde_copy(uint32_t *page_dir);
+bool cow_share(uint32_t *child_pg_dir);
+void *kmap(uint32_t pg_phy_addr);
+void kunmap(void *vaddr);
+void *get_user_page(uint32_t pg_cnt);
+void *malloc_page(enum pool_flags pf, uint32_t pg_cnt);
+void *palloc(struct pool *m_pool);
+void *palloc_zeroed(struct pool *m_pool, bool *zeroed);
+void *palloc_contig(struct pool *m_pool, uint32_t pg_cnt);
+void pfree_contig(struct pool *m_pool, void *pg_phy_addr, uint32_t pg_cnt);
+void pfree(uint32_t pg_phy_addr);
+void frame_ref_get(uint32_t pg_phy_addr);
+uint16_t frame_ref_cnt(uint32_t pg_phy_addr);
+void mfree_page(enum pool_flags pf, void *_vaddr, uint32_t pg_cnt);
+void mapping_stat(uint32_t *large_cnt, uint32_t *small_cnt);
+void zero_thread_init(void);
+void zero_reserve_stat(enum pool_flags pf, uint32_t *cnt, uint32_t *hits, uint32_t *misses);
+void block_desc_init(struct mem_block_desc *desc_array);
+void *sys_malloc(uint32_t size);
+void sys_free(void *ptr);
+void sys_memstat(struct mem_stat *stat);
 
 #endif
\ No newline at end of file
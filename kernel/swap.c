@@ -0,0 +1,265 @@
+#include "swap.h"
+#include "ata.h"
+#include "bitmap.h"
+#include "debug.h"
+#include "global.h"
+#include "list.h"
+#include "memory.h"
+#include "print.h"
+#include "sync.h"
+#include "thread.h"
+#include "zram.h"
+
+extern struct list thread_all_list;
+
+/* 一个交换槽位占用的扇区数 */
+#define SECTORS_PER_SLOT (PAGE_SIZE / SECTOR_SIZE)
+
+/* 交换槽位的分配位图及其摘要位图 */
+static uint8_t swap_bits[SWAP_SLOTS / 8];
+static uint32_t swap_summary[BITMAP_SUMMARY_BYTES(SWAP_SLOTS / 8) / 4];
+static struct bitmap swap_bitmap;
+static uint32_t swap_used_slots;
+
+/* 保护交换位图、压缩池和时钟指针；换出的整个过程都持有它，换入因此不会读到尚未写完的页面 */
+static struct lock swap_lock;
+
+/* 时钟指针：下一次从进程 clock_task 地址空间中的 clock_vaddr 处继续扫描 */
+static struct task_struct *clock_task;
+static uint32_t clock_vaddr;
+
+/* swap_init - 初始化交换区 */
+void swap_init(void) {
+    put_str("  swap_init start\n");
+    swap_bitmap.bmap_bytes_len = sizeof(swap_bits);
+    swap_bitmap.bits = swap_bits;
+    swap_bitmap.summary = swap_summary;
+    bitmap_init(&swap_bitmap);
+    lock_init(&swap_lock);
+    put_str("  swap_init done\n");
+}
+
+/* tlb_invalidate_page - 使当前地址空间中 vaddr 的 TLB 项失效 */
+static void tlb_invalidate_page(uint32_t vaddr) {
+    asm volatile("invlpg %0" ::"m"(*(char *)vaddr) : "memory");
+}
+
+/**
+ * clock_next_task - 从 task 之后找下一个用户进程
+ * @task: 当前进程，为 NULL 时从队首开始
+ *
+ * 到达队尾时回到队首，所有任务都看过一遍仍没有用户进程时返回 NULL。
+ */
+static struct task_struct *clock_next_task(struct task_struct *task) {
+    struct list_elem *elem = task != NULL ? task->all_list_tag.next : thread_all_list.head.next;
+    bool wrapped = false;
+    while (1) {
+        if (elem == &thread_all_list.tail) {
+            if (wrapped)
+                return NULL;
+            wrapped = true;
+            elem = thread_all_list.head.next;
+            continue;
+        }
+        struct task_struct *pthread = elem2entry(struct task_struct, all_list_tag, elem);
+        if (pthread->pg_dir != NULL)
+            return pthread;
+        elem = elem->next;
+    }
+}
+
+/**
+ * swap_out - 把进程 task 中由 pte 映射的页面换出
+ * @task: 页面所属的进程
+ * @pte: 页表项，页表经由临时映射窗口访问
+ * @vaddr: 页面的虚拟地址
+ *
+ * 共享内存页面和仍被多个进程共享的写时复制页面没有唯一的主人，不换出。
+ * 页面优先压缩存入压缩池，不可压缩或压缩池已满时才写入硬盘的交换槽位。
+ * 先撤销映射再读取页面内容，期间对该页面的访问会在换入时等待 swap_lock，不会丢失写入。
+ *
+ * 返回值: 换出成功返回 true。
+ */
+static bool swap_out(struct task_struct *task, uint32_t *pte, uint32_t vaddr) {
+    uint32_t old_pte = *pte;
+    uint32_t pg_phy_addr = old_pte & 0xfffff000;
+    if ((old_pte & PG_SHARED) || frame_ref_cnt(pg_phy_addr) > 0)
+        return false;
+
+    *pte = PG_SWAP;
+    if (task == running_thread())
+        tlb_invalidate_page(vaddr);
+
+    void *page = kmap(pg_phy_addr);
+    uint32_t entry;
+    int32_t handle = zram_store(page);
+    if (handle != -1) {
+        entry = SWAP_SLOTS + handle;
+    } else {
+        int32_t slot = bitmap_scan(&swap_bitmap, 1);
+        if (slot == -1) {
+            kunmap(page);
+            *pte = old_pte;
+            return false;
+        }
+        bitmap_set(&swap_bitmap, slot, 1);
+        swap_used_slots++;
+        ata_write(SWAP_START_LBA + slot * SECTORS_PER_SLOT, page, SECTORS_PER_SLOT);
+        entry = slot;
+    }
+    kunmap(page);
+
+    *pte = (entry << 12) | PG_SWAP;
+    task->rss_pages--;
+    pfree(pg_phy_addr);
+    return true;
+}
+
+/* swap_entry_free - 释放换出项 entry 占用的压缩池块或交换槽位，调用者持有 swap_lock */
+static void swap_entry_free(uint32_t entry) {
+    if (entry >= SWAP_SLOTS) {
+        zram_free(entry - SWAP_SLOTS);
+    } else {
+        bitmap_set(&swap_bitmap, entry, 0);
+        swap_used_slots--;
+    }
+}
+
+/**
+ * clock_scan_task - 从时钟指针处扫描进程 task 的用户地址空间
+ * @task: 用户进程
+ * @target: 需要回收的页面数
+ * @freed: 已回收的页面数，扫描过程中累加
+ * @budget: 还允许检查的页面数，扫描过程中递减
+ *
+ * 二次机会算法：访问位为1的页面清除访问位后跳过，访问位为0的页面换出。
+ * 其他进程的页表经由临时映射窗口访问，4MB 大页不参与换出。
+ *
+ * 返回值: 因达到 target 或用完 budget 而中途停止时返回 true，时钟指针停在下一个页面；
+ *         扫描到地址空间末尾时返回 false。
+ */
+static bool clock_scan_task(struct task_struct *task, uint32_t target, uint32_t *freed, uint32_t *budget) {
+    uint32_t vaddr = clock_vaddr;
+    while (vaddr < 0xc0000000) {
+        uint32_t pde = task->pg_dir[vaddr >> 22];
+        if (!(pde & PG_P_1) || (pde & PG_PS)) {
+            vaddr = (vaddr & 0xffc00000) + 0x400000;
+            continue;
+        }
+
+        uint32_t *pt = kmap(pde & 0xfffff000);
+        uint32_t idx;
+        for (idx = (vaddr >> 12) & 0x3ff; idx < 1024; idx++, vaddr += PAGE_SIZE) {
+            if (!(pt[idx] & PG_P_1))
+                continue;
+            (*budget)--;
+            if (pt[idx] & PG_A) {
+                pt[idx] &= ~PG_A;
+                if (task == running_thread())
+                    tlb_invalidate_page(vaddr);
+            } else if (swap_out(task, &pt[idx], vaddr)) {
+                (*freed)++;
+            }
+            if (*freed >= target || *budget == 0) {
+                kunmap(pt);
+                clock_vaddr = vaddr + PAGE_SIZE;
+                return true;
+            }
+        }
+        kunmap(pt);
+    }
+    return false;
+}
+
+/**
+ * swap_reclaim - 用户内存池耗尽时回收用户页面
+ * @pg_cnt: 希望回收的页面数
+ *
+ * 时钟指针依次扫过所有用户进程的页表。每个页面最多被检查两次：第一次清除访问位，
+ * 第二次仍未被访问就换出，因此检查次数以所有进程驻留页面数的两倍为限。
+ *
+ * 返回值: 实际回收的页面数，交换区已满或没有可换出的页面时为 0。
+ */
+uint32_t swap_reclaim(uint32_t pg_cnt) {
+    lock_acquire(&swap_lock);
+    uint32_t freed = 0, budget = 0;
+    struct task_struct *task = clock_next_task(NULL);
+    struct task_struct *first = task;
+    if (task != NULL) {
+        do {
+            budget += task->rss_pages;
+            task = clock_next_task(task);
+        } while (task != first);
+    }
+    budget *= 2;
+
+    if (clock_task == NULL || clock_task->pg_dir == NULL) {
+        clock_task = first;
+        clock_vaddr = 0;
+    }
+    while (clock_task != NULL && budget > 0 && freed < pg_cnt) {
+        if (clock_scan_task(clock_task, pg_cnt, &freed, &budget))
+            break;
+        clock_task = clock_next_task(clock_task);
+        clock_vaddr = 0;
+    }
+    lock_release(&swap_lock);
+    return freed;
+}
+
+/**
+ * swap_in - 把当前进程中已换出的页面 vaddr 读回内存
+ * @vaddr: 页对齐的用户虚拟地址
+ *
+ * 返回值: 页面确实已换出并成功读回时返回 true；页面未换出或内存不足时返回 false。
+ */
+bool swap_in(uint32_t vaddr) {
+    uint32_t *pde = pde_ptr(vaddr);
+    if (!(*pde & PG_P_1) || (*pde & PG_PS))
+        return false;
+    uint32_t *pte = pte_ptr(vaddr);
+    if ((*pte & PG_P_1) || !(*pte & PG_SWAP))
+        return false;
+
+    /* 分配页框时可能回收其他页面，但已换出的页面不会被再次选中 */
+    void *pg_phy_addr = palloc(&user_pool);
+    if (pg_phy_addr == NULL)
+        return false;
+
+    lock_acquire(&swap_lock);
+    /* 页面可能正在被换出，换出失败时映射已经恢复 */
+    if (*pte & PG_P_1) {
+        lock_release(&swap_lock);
+        pfree((uint32_t)pg_phy_addr);
+        return true;
+    }
+    uint32_t entry = *pte >> 12;
+    void *page = kmap((uint32_t)pg_phy_addr);
+    if (entry >= SWAP_SLOTS)
+        zram_load(entry - SWAP_SLOTS, page);
+    else
+        ata_read(SWAP_START_LBA + entry * SECTORS_PER_SLOT, page, SECTORS_PER_SLOT);
+    kunmap(page);
+    swap_entry_free(entry);
+    *pte = 0;
+    lock_release(&swap_lock);
+
+    map_range(vaddr, NULL, (uint32_t)pg_phy_addr, 1, PG_US_U | PG_RW_W);
+    return true;
+}
+
+/**
+ * swap_slot_free - 释放已换出页面占用的压缩池块或交换槽位
+ * @pte: 已换出页面的页表项
+ */
+void swap_slot_free(uint32_t pte) {
+    ASSERT(!(pte & PG_P_1) && (pte & PG_SWAP));
+    lock_acquire(&swap_lock);
+    swap_entry_free(pte >> 12);
+    lock_release(&swap_lock);
+}
+
+/* swap_used - 已使用的硬盘交换槽位数 */
+uint32_t swap_used(void) {
+    return swap_used_slots;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef __KERNEL_SWAP_H
+#define __KERNEL_SWAP_H
+#include "global.h"
+#include "stdint.h"
+
+/* 交换区在主盘上的起始扇区（10MB 处），内核映像只占用第 9 扇区起的 200 个扇区 */
+#define SWAP_START_LBA 20480
+/* 交换槽位数，每个槽位存放一个页面，共 16MB */
+#define SWAP_SLOTS 4096
+/* 换出页面的 PTE 高20位是换出项：小于 SWAP_SLOTS 时为硬盘交换槽位号，否则减去 SWAP_SLOTS 为压缩池句柄 */
+/* 用户内存池耗尽时一次回收的页面数 */
+#define SWAP_RECLAIM_BATCH 16
+
+void swap_init(void);
+uint32_t swap_reclaim(uint32_t pg_cnt);
+bool swap_in(uint32_t vaddr);
+void swap_slot_free(uint32_t pte);
+uint32_t swap_used(void);
+#endif
\ No newline at end of file
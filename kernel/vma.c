@@ -0,0 +1,270 @@
+#include "vma.h"
+#include "rbtree.h"
+#include "list.h"
+#include "memory.h"
+#include "interrupt.h"
+#include "debug.h"
+#include "global.h"
+
+#define PAGE_SIZE 4096
+
+/* 空闲的 vm_area 结构，按页从内核内存池切分而来，释放后放回这里重复使用 */
+static struct list vma_free_list;
+
+/* vma_init - 初始化 vm_area 结构的空闲链表 */
+void vma_init(void) {
+    list_init(&vma_free_list);
+}
+
+/**
+ * vma_struct_alloc - 分配一个 vm_area 结构。
+ *
+ * 空闲链表为空时向内核内存池申请一页并切分。空闲的 vm_area 与 mem_block 一样，
+ * 直接把结构开头当作 list_elem 挂在链表上。
+ *
+ * 返回值: 成功返回 vm_area 指针，内存不足返回 NULL。
+ */
+static struct vm_area *vma_struct_alloc(void) {
+    enum intr_status old_status = intr_disable();
+    if (list_empty(&vma_free_list)) {
+        intr_set_status(old_status);
+        struct vm_area *page = get_kernel_pages(1);
+        if (page == NULL)
+            return NULL;
+        uint32_t i;
+        for (i = 0; i < PAGE_SIZE / sizeof(struct vm_area); i++)
+            list_append(&vma_free_list, (struct list_elem *)&page[i]);
+        old_status = intr_disable();
+    }
+    struct vm_area *vma = (struct vm_area *)list_pop(&vma_free_list);
+    intr_set_status(old_status);
+    return vma;
+}
+
+/* vma_struct_free - 把 vm_area 结构放回空闲链表 */
+static void vma_struct_free(struct vm_area *vma) {
+    list_append(&vma_free_list, (struct list_elem *)vma);
+}
+
+/* node2vma - 由树节点得到所在的 vm_area */
+static struct vm_area *node2vma(struct rb_node *node) {
+    return elem2entry(struct vm_area, node, node);
+}
+
+/* vma_augment - 增强回调：max_gap 取自身 gap 与左右子树 max_gap 的最大值 */
+static void vma_augment(struct rb_node *node) {
+    struct vm_area *vma = node2vma(node);
+    uint32_t max_gap = vma->gap;
+    if (node->left != NULL) {
+        struct vm_area *left = node2vma(node->left);
+        if (left->max_gap > max_gap)
+            max_gap = left->max_gap;
+    }
+    if (node->right != NULL) {
+        struct vm_area *right = node2vma(node->right);
+        if (right->max_gap > max_gap)
+            max_gap = right->max_gap;
+    }
+    vma->max_gap = max_gap;
+}
+
+/* vma_gap_update - 按前一个区域重新计算 vma 的 gap，并向上更新 max_gap */
+static void vma_gap_update(struct vma_tree *tree, struct vm_area *vma) {
+    struct rb_node *prev = rb_prev(&vma->node);
+    uint32_t prev_end = prev != NULL ? node2vma(prev)->end : tree->vaddr_start;
+    vma->gap = vma->start - prev_end;
+    rb_augment_propagate(&vma->node, vma_augment);
+}
+
+/* vma_next - 返回地址上紧随 vma 的区域，没有则返回 NULL */
+static struct vm_area *vma_next(struct vm_area *vma) {
+    struct rb_node *next = rb_next(&vma->node);
+    return next != NULL ? node2vma(next) : NULL;
+}
+
+/**
+ * vma_first_after - 查找第一个结束地址大于 vaddr 的区域。
+ *
+ * 区域互不重叠，按 start 排序也就按 end 排序，因此可以二分查找。
+ */
+static struct vm_area *vma_first_after(struct vma_tree *tree, uint32_t vaddr) {
+    struct rb_node *node = tree->root.node;
+    struct vm_area *found = NULL;
+    while (node != NULL) {
+        struct vm_area *vma = node2vma(node);
+        if (vma->end > vaddr) {
+            found = vma;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return found;
+}
+
+/**
+ * vma_tree_init - 初始化一个空的地址空间。
+ * @tree: 要初始化的树。
+ * @vaddr_start: 可分配虚拟地址的起点。
+ * @vaddr_end: 可分配虚拟地址的终点（不含）。
+ */
+void vma_tree_init(struct vma_tree *tree, uint32_t vaddr_start, uint32_t vaddr_end) {
+    rb_root_init(&tree->root);
+    tree->vaddr_start = vaddr_start;
+    tree->vaddr_end = vaddr_end;
+    tree->reserved_pages = 0;
+}
+
+/**
+ * vma_find - 查找包含虚拟地址 vaddr 的区域。
+ *
+ * 返回值: 找到则返回该区域，否则返回 NULL。
+ */
+struct vm_area *vma_find(struct vma_tree *tree, uint32_t vaddr) {
+    struct vm_area *vma = vma_first_after(tree, vaddr);
+    return (vma != NULL && vma->start <= vaddr) ? vma : NULL;
+}
+
+/**
+ * vma_insert - 预留指定的虚拟地址范围 [start, end)。
+ * @tree: 地址空间。
+ * @start: 起始地址，页对齐。
+ * @end: 结束地址（不含），页对齐。
+ * @flags: 区域标志。
+ *
+ * 返回值: 成功返回 true；与已有区域重叠、超出地址空间或内存不足时返回 false。
+ */
+bool vma_insert(struct vma_tree *tree, uint32_t start, uint32_t end, uint32_t flags) {
+    ASSERT(start % PAGE_SIZE == 0 && end % PAGE_SIZE == 0 && start < end);
+    if (start < tree->vaddr_start || end > tree->vaddr_end)
+        return false;
+    struct vm_area *next = vma_first_after(tree, start);
+    if (next != NULL && next->start < end)
+        return false;
+
+    struct vm_area *vma = vma_struct_alloc();
+    if (vma == NULL)
+        return false;
+    vma->start = start;
+    vma->end = end;
+    vma->flags = flags;
+    vma->shm_id = -1;
+
+    struct rb_node **link = &tree->root.node, *parent = NULL;
+    while (*link != NULL) {
+        parent = *link;
+        link = start < node2vma(parent)->start ? &parent->left : &parent->right;
+    }
+    rb_link_node(&vma->node, parent, link);
+    struct rb_node *prev = rb_prev(&vma->node);
+    vma->gap = start - (prev != NULL ? node2vma(prev)->end : tree->vaddr_start);
+    vma->max_gap = vma->gap;
+    rb_insert_color(&tree->root, &vma->node, vma_augment);
+
+    /* 后一个区域前面的空闲地址变小了 */
+    if (next != NULL)
+        vma_gap_update(tree, next);
+    tree->reserved_pages += (end - start) / PAGE_SIZE;
+    return true;
+}
+
+/**
+ * vma_alloc - 在地址空间中找一段至少 pg_cnt 页的空闲地址并预留。
+ * @tree: 地址空间。
+ * @pg_cnt: 页面数量。
+ * @flags: 新区域的标志。
+ *
+ * 利用每个子树的 max_gap 从根向下查找地址最低的足够大的空隙，找不到再看最后一个区域之后的空间。
+ *
+ * 返回值: 成功返回起始虚拟地址，失败返回 0。
+ */
+uint32_t vma_alloc(struct vma_tree *tree, uint32_t pg_cnt, uint32_t flags) {
+    uint32_t size = pg_cnt * PAGE_SIZE;
+    uint32_t start = 0;
+    struct rb_node *node = tree->root.node;
+
+    if (node != NULL && node2vma(node)->max_gap >= size) {
+        while (node != NULL) {
+            struct vm_area *vma = node2vma(node);
+            if (node->left != NULL && node2vma(node->left)->max_gap >= size) {
+                node = node->left;
+            } else if (vma->gap >= size) {
+                start = vma->start - vma->gap;
+                break;
+            } else {
+                node = node->right;
+            }
+        }
+        ASSERT(start != 0);
+    } else {
+        struct rb_node *last = rb_last(&tree->root);
+        start = last != NULL ? node2vma(last)->end : tree->vaddr_start;
+        if (tree->vaddr_end - start < size)
+            return 0;
+    }
+    return vma_insert(tree, start, start + size, flags) ? start : 0;
+}
+
+/**
+ * vma_remove - 取消预留虚拟地址范围 [start, end)。
+ * @tree: 地址空间。
+ * @start: 起始地址，页对齐。
+ * @end: 结束地址（不含），页对齐。
+ *
+ * 完全落在范围内的区域被删除，部分重叠的区域被截短，范围位于某个区域中间时把该区域一分为二。
+ */
+void vma_remove(struct vma_tree *tree, uint32_t start, uint32_t end) {
+    ASSERT(start % PAGE_SIZE == 0 && end % PAGE_SIZE == 0 && start < end);
+    struct vm_area *vma = vma_first_after(tree, start);
+
+    while (vma != NULL && vma->start < end) {
+        struct vm_area *next = vma_next(vma);
+        uint32_t cut_start = vma->start > start ? vma->start : start;
+        uint32_t cut_end = vma->end < end ? vma->end : end;
+        tree->reserved_pages -= (cut_end - cut_start) / PAGE_SIZE;
+
+        if (vma->start >= start && vma->end <= end) {
+            rb_erase(&tree->root, &vma->node, vma_augment);
+            vma_struct_free(vma);
+            if (next != NULL)
+                vma_gap_update(tree, next);
+        } else if (vma->start < start && vma->end > end) {
+            uint32_t tail_end = vma->end;
+            vma->end = start;
+            tree->reserved_pages -= (tail_end - end) / PAGE_SIZE;
+            if (!vma_insert(tree, end, tail_end, vma->flags))
+                PANIC("vma_remove: no memory to split area");
+            vma_find(tree, end)->shm_id = vma->shm_id;
+        } else if (vma->start < start) {
+            vma->end = start;
+            if (next != NULL)
+                vma_gap_update(tree, next);
+        } else {
+            vma->start = end;
+            vma_gap_update(tree, vma);
+        }
+        vma = next;
+    }
+}
+
+/**
+ * vma_tree_copy - 把 src 中的全部区域复制到 dst，用于 fork。
+ * @dst: 目标地址空间，其中原有的内容被忽略。
+ * @src: 源地址空间。
+ *
+ * 返回值: 成功返回 true；内存不足时释放 dst 中已复制的区域并返回 false。
+ */
+bool vma_tree_copy(struct vma_tree *dst, struct vma_tree *src) {
+    vma_tree_init(dst, src->vaddr_start, src->vaddr_end);
+    struct rb_node *node;
+    for (node = rb_first(&src->root); node != NULL; node = rb_next(node)) {
+        struct vm_area *vma = node2vma(node);
+        if (!vma_insert(dst, vma->start, vma->end, vma->flags)) {
+            if (dst->root.node != NULL)
+                vma_remove(dst, dst->vaddr_start, dst->vaddr_end);
+            return false;
+        }
+        vma_find(dst, vma->start)->shm_id = vma->shm_id;
+    }
+    return true;
+}
\ No newline at end of file
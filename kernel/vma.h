@@ -0,0 +1,53 @@
+#ifndef __KERNEL_VMA_H
+#define __KERNEL_VMA_H
+#include "global.h"
+#include "stdint.h"
+#include "rbtree.h"
+
+/* 虚拟内存区域标志 */
+#define VMA_STACK 1 //用户栈区域，缺页时只允许在栈指针附近按需增长
+#define VMA_SHM   2 //共享内存区域，页面在 attach 时全部映射
+
+/**
+ * struct vm_area - 虚拟内存区域，描述进程地址空间中一段已预留的虚拟地址 [start, end)。
+ * @node: 在 vma_tree 中按 start 排序的节点。
+ * @start: 起始虚拟地址，页对齐。
+ * @end: 结束虚拟地址（不含），页对齐。
+ * @flags: 区域标志，如 VMA_STACK。
+ * @shm_id: VMA_SHM 区域映射的共享内存段编号，其他区域为 -1。
+ * @gap: 本区域与前一个区域（或地址空间起点）之间空闲地址的字节数。
+ * @max_gap: 以本节点为根的子树中最大的 gap，用于 O(log n) 查找足够大的空闲地址。
+ */
+struct vm_area {
+    struct rb_node node;
+    uint32_t start;
+    uint32_t end;
+    uint32_t flags;
+    int32_t shm_id;
+    uint32_t gap;
+    uint32_t max_gap;
+};
+
+/**
+ * struct vma_tree - 一个地址空间中全部虚拟内存区域构成的红黑树。
+ * @root: 按起始地址排序的红黑树。
+ * @vaddr_start: 可分配虚拟地址的起点。
+ * @vaddr_end: 可分配虚拟地址的终点（不含）。
+ * @reserved_pages: 所有区域合计预留的虚拟页面数。
+ */
+struct vma_tree {
+    struct rb_root root;
+    uint32_t vaddr_start;
+    uint32_t vaddr_end;
+    uint32_t reserved_pages;
+};
+
+void vma_init(void);
+void vma_tree_init(struct vma_tree *tree, uint32_t vaddr_start, uint32_t vaddr_end);
+struct vm_area *vma_find(struct vma_tree *tree, uint32_t vaddr);
+bool vma_insert(struct vma_tree *tree, uint32_t start, uint32_t end, uint32_t flags);
+uint32_t vma_alloc(struct vma_tree *tree, uint32_t pg_cnt, uint32_t flags);
+void vma_remove(struct vma_tree *tree, uint32_t start, uint32_t end);
+bool vma_tree_copy(struct vma_tree *dst, struct vma_tree *src);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "zram.h"
+#include "debug.h"
+#include "io.h"
+#include "lz.h"
+#include "memory.h"
+#include "string.h"
+#include "syscall.h"
+
+/* 延迟统计的指数滑动平均中，新样本占 1 / (1 << ZRAM_EMA_SHIFT) 的权重 */
+#define ZRAM_EMA_SHIFT 3
+
+/**
+ * struct zram_page - 压缩池中的一个内核页面
+ * @base: 页面的内核虚拟地址，为 NULL 表示该槽位尚未分配页面
+ * @used_map: 各块的占用情况，第 i 位为 1 表示第 i 块已被占用
+ */
+struct zram_page {
+    uint8_t *base;
+    uint16_t used_map;
+};
+
+/*
+ * 压缩池的句柄为 池页面下标 * ZRAM_CHUNKS + 起始块号。
+ * 以下数据都由 swap_lock 保护，zram 的所有函数只在持有 swap_lock 时调用。
+ */
+static struct zram_page pool[ZRAM_POOL_PAGES];
+static uint16_t obj_len[ZRAM_HANDLES];
+static uint8_t compress_buf[ZRAM_MAX_STORE];
+static uint16_t hash_table[LZ_HASH_SIZE];
+
+static uint32_t stored_pages, stored_bytes, pool_pages, rejected;
+static uint32_t store_cycles, load_cycles;
+
+/* cycles_update - 把一次测量的周期数计入指数滑动平均 */
+static void cycles_update(uint32_t *avg, uint64_t start) {
+    uint32_t sample = (uint32_t)(rdtsc() - start);
+    if (*avg == 0)
+        *avg = sample;
+    else
+        *avg = *avg - (*avg >> ZRAM_EMA_SHIFT) + (sample >> ZRAM_EMA_SHIFT);
+}
+
+/* chunk_run_find - 在 used_map 中找 n 个连续的空闲块，返回起始块号，找不到时返回 -1 */
+static int32_t chunk_run_find(uint16_t used_map, uint32_t n) {
+    uint32_t mask = (1 << n) - 1, i;
+    for (i = 0; i + n <= ZRAM_CHUNKS; i++) {
+        if (!(used_map & (mask << i)))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * zram_store - 把一个页面压缩后存入压缩池
+ * @page: 页面的内核虚拟地址
+ *
+ * 依次在已分配的池页面中找能容纳压缩结果的连续空闲块，都放不下时再分配一个内核页面。
+ *
+ * 返回值: 句柄；页面不可压缩、压缩池已满或内核内存不足时返回 -1，调用者改为换出到硬盘。
+ */
+int32_t zram_store(const void *page) {
+    uint64_t start = rdtsc();
+    uint32_t len = lz_compress(page, PAGE_SIZE, compress_buf, ZRAM_MAX_STORE, hash_table);
+    if (len == 0) {
+        rejected++;
+        return -1;
+    }
+
+    uint32_t n = DIV_ROUND_UP(len, ZRAM_CHUNK_SIZE);
+    int32_t idx, empty_idx = -1, chunk = -1;
+    for (idx = 0; idx < ZRAM_POOL_PAGES; idx++) {
+        if (pool[idx].base == NULL) {
+            if (empty_idx == -1)
+                empty_idx = idx;
+            continue;
+        }
+        chunk = chunk_run_find(pool[idx].used_map, n);
+        if (chunk != -1)
+            break;
+    }
+    if (idx == ZRAM_POOL_PAGES) {
+        if (empty_idx == -1)
+            return -1;
+        uint8_t *base = get_kernel_pages(1);
+        if (base == NULL)
+            return -1;
+        idx = empty_idx;
+        pool[idx].base = base;
+        pool[idx].used_map = 0;
+        pool_pages++;
+        chunk = 0;
+    }
+
+    pool[idx].used_map |= ((1 << n) - 1) << chunk;
+    memcpy(pool[idx].base + chunk * ZRAM_CHUNK_SIZE, compress_buf, len);
+    uint32_t handle = idx * ZRAM_CHUNKS + chunk;
+    obj_len[handle] = len;
+    stored_pages++;
+    stored_bytes += len;
+    cycles_update(&store_cycles, start);
+    return handle;
+}
+
+/**
+ * zram_load - 把句柄 handle 对应的页面解压到 page
+ * @handle: zram_store 返回的句柄
+ * @page: 目标页面的内核虚拟地址
+ *
+ * 只解压，不释放句柄。
+ */
+void zram_load(uint32_t handle, void *page) {
+    uint64_t start = rdtsc();
+    struct zram_page *zp = &pool[handle / ZRAM_CHUNKS];
+    ASSERT(handle < ZRAM_HANDLES && zp->base != NULL);
+    int32_t len = lz_decompress(zp->base + handle % ZRAM_CHUNKS * ZRAM_CHUNK_SIZE, obj_len[handle],
+                                page, PAGE_SIZE);
+    ASSERT(len == PAGE_SIZE);
+    cycles_update(&load_cycles, start);
+}
+
+/**
+ * zram_free - 释放句柄 handle 占用的块
+ * @handle: zram_store 返回的句柄
+ *
+ * 池页面的块全部空闲时把页面归还给内核内存池。
+ */
+void zram_free(uint32_t handle) {
+    struct zram_page *zp = &pool[handle / ZRAM_CHUNKS];
+    ASSERT(handle < ZRAM_HANDLES && zp->base != NULL);
+    uint32_t n = DIV_ROUND_UP(obj_len[handle], ZRAM_CHUNK_SIZE);
+    zp->used_map &= ~(((1 << n) - 1) << (handle % ZRAM_CHUNKS));
+    stored_pages--;
+    stored_bytes -= obj_len[handle];
+    if (zp->used_map == 0) {
+        mfree_page(PF_KERNEL, zp->base, 1);
+        zp->base = NULL;
+        pool_pages--;
+    }
+}
+
+/* zram_stat - 填写 stat 中压缩池的统计信息 */
+void zram_stat(struct mem_stat *stat) {
+    stat->zram_pages = stored_pages;
+    stat->zram_bytes = stored_bytes;
+    stat->zram_pool_pages = pool_pages;
+    stat->zram_rejected = rejected;
+    stat->zram_store_cycles = store_cycles;
+    stat->zram_load_cycles = load_cycles;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef __KERNEL_ZRAM_H
+#define __KERNEL_ZRAM_H
+#include "global.h"
+#include "stdint.h"
+
+/* 压缩池最多占用的内核页面数，即 2MB */
+#define ZRAM_POOL_PAGES 512
+/* 压缩池页面按块分配，一个压缩后的页面占用同一池页面中连续的若干块 */
+#define ZRAM_CHUNK_SIZE 256
+#define ZRAM_CHUNKS (PAGE_SIZE / ZRAM_CHUNK_SIZE)
+/* 压缩池句柄的个数 */
+#define ZRAM_HANDLES (ZRAM_POOL_PAGES * ZRAM_CHUNKS)
+/* 压缩后超过这个大小的页面不值得放进压缩池，直接换出到硬盘 */
+#define ZRAM_MAX_STORE (PAGE_SIZE * 3 / 4)
+
+struct mem_stat;
+
+int32_t zram_store(const void *page);
+void zram_load(uint32_t handle, void *page);
+void zram_free(uint32_t handle);
+void zram_stat(struct mem_stat *stat);
+#endif
\ No newline at end of file
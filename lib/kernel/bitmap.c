@@ -1,18 +1,120 @@
 #include "bitmap.h"
+#include "bitops.h"
 #include "stdint.h"
 #include "debug.h"
 #include "interrupt.h"
 #include "print.h"
 #include "string.h"
 
+/**
+ * word_get - 读取位图中的第 w 个32位字。
+ * @btmp: 位图的指针。
+ * @w: 字的下标。
+ *
+ * 位图末尾不满一个字的部分，超出位图长度的位视为已置1；完全超出位图的字返回全1。
+ */
+static uint32_t word_get(struct bitmap *btmp, uint32_t w) {
+    uint32_t byte_off = w * 4;
+    if (byte_off + 4 <= btmp->bmap_bytes_len)
+        return *(uint32_t *)(btmp->bits + byte_off);
+
+    uint32_t val = 0xffffffff, i;
+    for (i = 0; byte_off + i < btmp->bmap_bytes_len; i++)
+        val = (val & ~(0xffu << (i * 8))) | ((uint32_t)btmp->bits[byte_off + i] << (i * 8));
+    return val;
+}
+
+/* summary_update - 按第 w 个字是否已全部置1更新摘要位图 */
+static void summary_update(struct bitmap *btmp, uint32_t w) {
+    if (btmp->summary == NULL)
+        return;
+    if (word_get(btmp, w) == 0xffffffff) {
+        btmp->summary[w / BITMAP_WORD_BITS] |= (uint32_t)BITMAP_MASK << (w % BITMAP_WORD_BITS);
+    } else {
+        btmp->summary[w / BITMAP_WORD_BITS] &= ~((uint32_t)BITMAP_MASK << (w % BITMAP_WORD_BITS));
+    }
+}
+
+/**
+ * next_zero_bit - 查找 [pos, end) 中第一个为0的位。
+ * @btmp: 位图的指针。
+ * @pos: 起始位。
+ * @end: 结束位（不含）。
+ *
+ * 有摘要位图时，一次跳过摘要中对应32个已满字（1024位）的区域。
+ *
+ * 返回值: 找到的位下标，没有则返回 end。
+ */
+static uint32_t next_zero_bit(struct bitmap *btmp, uint32_t pos, uint32_t end) {
+    while (pos < end) {
+        uint32_t w = pos / BITMAP_WORD_BITS;
+        if (btmp->summary != NULL) {
+            uint32_t sw = w / BITMAP_WORD_BITS;
+            uint32_t not_full = ~btmp->summary[sw] & (0xffffffff << (w % BITMAP_WORD_BITS));
+            if (not_full == 0) {
+                pos = (sw + 1) * BITMAP_WORD_BITS * BITMAP_WORD_BITS;
+                continue;
+            }
+            uint32_t next_w = sw * BITMAP_WORD_BITS + bit_scan_forward(not_full);
+            if (next_w != w) {
+                w = next_w;
+                pos = w * BITMAP_WORD_BITS;
+            }
+        }
+        uint32_t zeros = ~word_get(btmp, w) & (0xffffffff << (pos % BITMAP_WORD_BITS));
+        if (zeros != 0) {
+            pos = w * BITMAP_WORD_BITS + bit_scan_forward(zeros);
+            return pos < end ? pos : end;
+        }
+        pos = (w + 1) * BITMAP_WORD_BITS;
+    }
+    return end;
+}
+
+/* next_one_bit - 查找 [pos, end) 中第一个为1的位，没有则返回 end */
+static uint32_t next_one_bit(struct bitmap *btmp, uint32_t pos, uint32_t end) {
+    while (pos < end) {
+        uint32_t w = pos / BITMAP_WORD_BITS;
+        uint32_t ones = word_get(btmp, w) & (0xffffffff << (pos % BITMAP_WORD_BITS));
+        if (ones != 0) {
+            pos = w * BITMAP_WORD_BITS + bit_scan_forward(ones);
+            return pos < end ? pos : end;
+        }
+        pos = (w + 1) * BITMAP_WORD_BITS;
+    }
+    return end;
+}
+
+/**
+ * scan_range - 在 [start, end) 中查找 cnt 个连续为0的位。
+ *
+ * 返回值: 找到则返回起始位下标，否则返回-1。
+ */
+static int scan_range(struct bitmap *btmp, uint32_t start, uint32_t end, uint32_t cnt) {
+    uint32_t pos = start;
+    while (pos + cnt <= end) {
+        pos = next_zero_bit(btmp, pos, end);
+        if (pos + cnt > end)
+            break;
+        uint32_t stop = next_one_bit(btmp, pos, pos + cnt);
+        if (stop == pos + cnt)
+            return pos;
+        pos = stop;
+    }
+    return -1;
+}
+
 /**
  * bitmap_init - 初始化位图。
  * @btmp: 要初始化的位图的指针。
  *
- * 将提供的位图中的所有位设置为0。
+ * 将提供的位图中的所有位设置为0，同时清空摘要位图并把扫描起点置为0。
  */
 void bitmap_init(struct bitmap *btmp) {
     memset(btmp->bits, 0, btmp->bmap_bytes_len);
+    if (btmp->summary != NULL)
+        memset(btmp->summary, 0, BITMAP_SUMMARY_BYTES(btmp->bmap_bytes_len));
+    btmp->hint = 0;
 }
 
 /**
@@ -34,49 +136,25 @@ bool bitmap_bit_test(struct bitmap *btmp, uint32_t bit_idx) {
  * @btmp: 位图的指针。
  * @cnt: 要查找的连续未设置（0）位的数量。
  *
- * 扫描至少长为'cnt'位的未设置位序列。
+ * 从上次分配结束的位置（hint）开始按32位字扫描，到达末尾后再从头扫描到 hint，
+ * 找到后把 hint 移到该序列之后。
  *
  * 返回值: 如果找到序列，则返回其起始索引，否则返回-1。
  */
 int bitmap_scan(struct bitmap *btmp, uint32_t cnt) {
-    uint32_t byte_idx = 0;
-    /* 通过按字节进行测试以排除全部为1的字节 */
-    while ((0xff == btmp->bits[byte_idx]) && (byte_idx < btmp->bmap_bytes_len))
-        ++byte_idx;
-
-    ASSERT(byte_idx < btmp->bmap_bytes_len);
-    /* 所有字节均为1，因此没有位为0，返回-1 */
-    if (byte_idx == btmp->bmap_bytes_len)
+    uint32_t total = btmp->bmap_bytes_len * 8;
+    if (cnt == 0 || cnt > total)
         return -1;
 
-    /* 通过逐位比较来查找第一个字节中的位0的位置。 */
-    int bit_idx = 0;
-    while ((uint8_t)(BITMAP_MASK << bit_idx) & btmp->bits[byte_idx])
-        ++bit_idx;
-
-    /* free_bit_idx_start 是整个位图中第一个位0的索引 */
-    int free_bit_idx_start = byte_idx * 8 + bit_idx;
-    if (cnt == 1)
-        return free_bit_idx_start;
-
-    uint32_t bit_left = btmp->bmap_bytes_len * 8 - free_bit_idx_start;
-    uint32_t next_bit = free_bit_idx_start + 1;
-    uint32_t count = 1;
-    free_bit_idx_start = -1;
-
-    /* 从 free_bit_idx_start 后的位开始遍历位图中的位，并找到序列 */
-    while (bit_left-- > 0) {
-        if (!bitmap_bit_test(btmp, next_bit)) {
-            ++count;
-        } else {
-            count = 0;
-        }
-        if (count == cnt) {
-            free_bit_idx_start = next_bit - cnt + 1;
-            break;
-        }
-        ++next_bit;
+    uint32_t hint = btmp->hint < total ? btmp->hint : 0;
+    int free_bit_idx_start = scan_range(btmp, hint, total, cnt);
+    /* 回绕扫描时允许序列跨过 hint */
+    if (free_bit_idx_start == -1 && hint > 0) {
+        uint32_t end = hint + cnt - 1 < total ? hint + cnt - 1 : total;
+        free_bit_idx_start = scan_range(btmp, 0, end, cnt);
     }
+    if (free_bit_idx_start != -1)
+        btmp->hint = free_bit_idx_start + cnt;
     return free_bit_idx_start;
 }
 
@@ -98,4 +176,45 @@ void bitmap_set(struct bitmap *btmp, uint32_t bit_idx, int8_t value) {
     } else {
         btmp->bits[byte_idx] &= ~(BITMAP_MASK << bit_idx_in_byte);
     }
+    summary_update(btmp, bit_idx / BITMAP_WORD_BITS);
+}
+
+/**
+ * bitmap_set_range - 把位图中从 bit_idx 起的 cnt 位设置为 value。
+ * @btmp: 位图的指针。
+ * @bit_idx: 起始位的索引。
+ * @cnt: 位的数量。
+ * @value: 要将位设置为的值（0或1）。
+ *
+ * 按32位字整体修改，每个字只更新一次摘要位图。
+ */
+void bitmap_set_range(struct bitmap *btmp, uint32_t bit_idx, uint32_t cnt, int8_t value) {
+    ASSERT((value == 0) || (value == 1));
+    ASSERT(bit_idx + cnt <= btmp->bmap_bytes_len * 8);
+
+    while (cnt > 0) {
+        uint32_t w = bit_idx / BITMAP_WORD_BITS;
+        uint32_t off = bit_idx % BITMAP_WORD_BITS;
+        uint32_t n = BITMAP_WORD_BITS - off < cnt ? BITMAP_WORD_BITS - off : cnt;
+        uint32_t mask = n == BITMAP_WORD_BITS ? 0xffffffff : (((uint32_t)BITMAP_MASK << n) - 1) << off;
+
+        if (w * 4 + 4 <= btmp->bmap_bytes_len) {
+            uint32_t *word = (uint32_t *)(btmp->bits + w * 4);
+            *word = value ? (*word | mask) : (*word & ~mask);
+        } else {
+            /* 位图末尾不满一个字的部分逐字节修改 */
+            uint32_t i;
+            for (i = 0; w * 4 + i < btmp->bmap_bytes_len; i++) {
+                uint8_t byte_mask = (uint8_t)(mask >> (i * 8));
+                if (value) {
+                    btmp->bits[w * 4 + i] |= byte_mask;
+                } else {
+                    btmp->bits[w * 4 + i] &= ~byte_mask;
+                }
+            }
+        }
+        summary_update(btmp, w);
+        bit_idx += n;
+        cnt -= n;
+    }
 }
\ No newline at end of file
@@ -6,21 +6,33 @@
 
 #define BITMAP_MASK 1
 
+/* 位图按32位字扫描，摘要位图中每一位对应位图中的一个字 */
+#define BITMAP_WORD_BITS 32
+
+/* 字节长度为 bytes_len 的位图所需摘要位图的字节数 */
+#define BITMAP_SUMMARY_BYTES(bytes_len) (DIV_ROUND_UP(DIV_ROUND_UP(bytes_len, 4), BITMAP_WORD_BITS) * 4)
+
 /**
  * struct bitmap - 表示位图数据结构。
  * @bmap_bytes_len: 位图的字节长度。
  * @bits: 指向表示位图的字节数组的指针。
+ * @summary: 可选的摘要位图，第 w 位为1表示 bits 的第 w 个32位字已全部置1；为 NULL 时不使用。
+ * @hint: 下次扫描的起始位，由 bitmap_scan 更新，实现循环首次适应（next-fit）。
  *
  * 此结构用于管理位图，一种有效表示二进制数据的位集合。
+ * 使用前需设置 bmap_bytes_len、bits 与 summary，再调用 bitmap_init。
  */
 struct bitmap {
     uint32_t bmap_bytes_len;
     uint8_t *bits;
+    uint32_t *summary;
+    uint32_t hint;
 };
 
 void bitmap_init(struct bitmap *btmp);
 bool bitmap_bit_test(struct bitmap *btmp, uint32_t bit_idx);
 int  bitmap_scan(struct bitmap *btmp, uint32_t cnt);
 void bitmap_set(struct bitmap *btmp, uint32_t bit_idx, int8_t value);
+void bitmap_set_range(struct bitmap *btmp, uint32_t bit_idx, uint32_t cnt, int8_t value);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef __LIB_KERNEL_BITOPS_H
+#define __LIB_KERNEL_BITOPS_H
+
+#include "stdint.h"
+
+/**
+ * bit_scan_forward - 返回 val 中最低的置1位的下标
+ * @val: 要扫描的字，不能为0
+ *
+ * 位图和各调度类的多级就绪队列都用它在常数时间内找到第一个置1位。
+ */
+static inline uint32_t bit_scan_forward(uint32_t val) {
+    uint32_t idx;
+    asm("bsf %1, %0" : "=r"(idx) : "rm"(val) : "cc");
+    return idx;
+}
+
+#endif
\ No newline at end of file
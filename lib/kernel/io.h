@@ -44,4 +44,15 @@ static inline void insw(uint16_t port, void *addr, uint32_t word_cnt) {
     asm volatile("cld; rep insw": "+D"(addr), "+c"(word_cnt): "d"(port) : "memory");
 }
 
+/**
+ * rdtsc - 读取时间戳计数器
+ *
+ * 返回：处理器上电以来经过的时钟周期数，用于测量短时间间隔。
+ */
+static inline uint64_t rdtsc(void) {
+    uint64_t tsc;
+    asm volatile("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
 #endif
\ No newline at end of file
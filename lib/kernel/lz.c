@@ -0,0 +1,159 @@
+#include "lz.h"
+#include "string.h"
+
+/*
+ * 采用 LZ4 的块格式：每个序列以一个标记字节开头，高4位为字面量长度，低4位为匹配长度减 LZ_MIN_MATCH，
+ * 取值 15 时后面跟若干个扩展字节（255 表示继续）。之后依次是字面量、2 字节小端的回溯距离和匹配长度的扩展字节。
+ * 最后一个序列只有字面量。回溯距离用 16 位表示，因此输入不能超过 64KB。
+ */
+#define LZ_MIN_MATCH 4
+/* 输入末尾的这些字节总是作为字面量输出 */
+#define LZ_LAST_LITERALS 5
+/* 距离输入末尾不足这么多字节时不再开始新的匹配 */
+#define LZ_MF_LIMIT 12
+
+/* lz_read32 - 读取 p 处的4个字节，p 不必对齐 */
+static uint32_t lz_read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* lz_hash - 把4个字节映射为哈希表的下标 */
+static uint32_t lz_hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* lz_put_len - 输出长度 len 的扩展字节，返回新的输出位置 */
+static uint8_t *lz_put_len(uint8_t *op, uint32_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+/**
+ * lz_compress - 压缩一块数据
+ * @src: 输入
+ * @src_len: 输入长度，不能超过 64KB
+ * @dst: 输出缓冲区
+ * @dst_cap: 输出缓冲区的容量
+ * @table: LZ_HASH_SIZE 项的哈希表，由调用者提供，内容无需初始化
+ *
+ * 贪心匹配：用哈希表记录每个4字节序列最近出现的位置，命中后尽量向后延长匹配。
+ * 哈希表由调用者提供，这样内核栈上不必放下 8KB 的数组。
+ *
+ * 返回值: 压缩后的长度；输出超过 dst_cap（数据不可压缩）时返回 0。
+ */
+uint32_t lz_compress(const void *src, uint32_t src_len, void *dst, uint32_t dst_cap, uint16_t *table) {
+    const uint8_t *base = src, *ip = src, *anchor = src;
+    const uint8_t *iend = base + src_len;
+    uint8_t *op = dst, *oend = op + dst_cap;
+    uint32_t lit_len;
+
+    memset(table, 0, LZ_HASH_SIZE * sizeof(uint16_t));
+    if (src_len >= LZ_MF_LIMIT) {
+        const uint8_t *mflimit = iend - LZ_MF_LIMIT, *matchlimit = iend - LZ_LAST_LITERALS;
+        while (ip < mflimit) {
+            uint32_t seq = lz_read32(ip);
+            uint32_t h = lz_hash(seq);
+            const uint8_t *ref = base + table[h];
+            table[h] = ip - base;
+            if (ref >= ip || ip - ref > 0xffff || lz_read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            const uint8_t *mp = ip + LZ_MIN_MATCH, *rp = ref + LZ_MIN_MATCH;
+            while (mp < matchlimit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+            lit_len = ip - anchor;
+            uint32_t match_len = mp - ip - LZ_MIN_MATCH;
+            if (op + 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1 > oend)
+                return 0;
+
+            uint8_t *token = op++;
+            *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+            if (lit_len >= 15)
+                op = lz_put_len(op, lit_len - 15);
+            memcpy(op, anchor, lit_len);
+            op += lit_len;
+            *op++ = (ip - ref) & 0xff;
+            *op++ = (ip - ref) >> 8;
+            *token |= match_len >= 15 ? 15 : match_len;
+            if (match_len >= 15)
+                op = lz_put_len(op, match_len - 15);
+            ip = anchor = mp;
+        }
+    }
+
+    lit_len = iend - anchor;
+    if (op + 1 + lit_len / 255 + 1 + lit_len > oend)
+        return 0;
+    *op++ = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15)
+        op = lz_put_len(op, lit_len - 15);
+    memcpy(op, anchor, lit_len);
+    op += lit_len;
+    return op - (uint8_t *)dst;
+}
+
+/**
+ * lz_decompress - 解压 lz_compress 的输出
+ * @src: 压缩数据
+ * @src_len: 压缩数据的长度
+ * @dst: 输出缓冲区
+ * @dst_cap: 输出缓冲区的容量
+ *
+ * 回溯距离可能小于匹配长度（如连续重复的字节），因此匹配部分逐字节复制。
+ *
+ * 返回值: 解压后的长度；数据损坏或输出超过 dst_cap 时返回 -1。
+ */
+int32_t lz_decompress(const void *src, uint32_t src_len, void *dst, uint32_t dst_cap) {
+    const uint8_t *ip = src, *iend = ip + src_len;
+    uint8_t *op = dst, *oend = op + dst_cap;
+    while (ip < iend) {
+        uint8_t token = *ip++, b;
+        uint32_t len = token >> 4;
+        if (len == 15) {
+            do {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op))
+            return -1;
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (uint32_t)(op - (uint8_t *)dst))
+            return -1;
+        len = token & 15;
+        if (len == 15) {
+            do {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += LZ_MIN_MATCH;
+        if (len > (uint32_t)(oend - op))
+            return -1;
+        const uint8_t *ref = op - offset;
+        while (len-- > 0)
+            *op++ = *ref++;
+    }
+    return op - (uint8_t *)dst;
+}
\ No newline at end of file
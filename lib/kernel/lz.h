@@ -0,0 +1,11 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+#include "stdint.h"
+
+/* 压缩时哈希表的位数，哈希表共 1 << LZ_HASH_BITS 项，每项 2 字节 */
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+
+uint32_t lz_compress(const void *src, uint32_t src_len, void *dst, uint32_t dst_cap, uint16_t *table);
+int32_t lz_decompress(const void *src, uint32_t src_len, void *dst, uint32_t dst_cap);
+#endif
\ No newline at end of file
@@ -0,0 +1,292 @@
+#include "rbtree.h"
+#include "global.h"
+
+/* rb_root_init - 初始化一棵空树 */
+void rb_root_init(struct rb_root *root) {
+    root->node = NULL;
+}
+
+/**
+ * rb_link_node - 把新节点挂到查找得到的位置上。
+ * @node: 新节点。
+ * @parent: 新节点的父节点，树为空时为 NULL。
+ * @link: 父节点中指向新节点的指针（&parent->left 或 &parent->right，空树时为 &root->node）。
+ *
+ * 调用者按自己的键从根向下查找到空位后调用，之后必须调用 rb_insert_color 恢复平衡。
+ */
+void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link) {
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->color = RB_RED;
+    *link = node;
+}
+
+/* replace_child - 把 parent 中指向 old 的指针改为指向 new，parent 为 NULL 时替换根节点 */
+static void replace_child(struct rb_root *root, struct rb_node *parent, struct rb_node *old, struct rb_node *new) {
+    if (parent == NULL) {
+        root->node = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+/* rotate_left - 以 x 为支点左旋，x 的右子节点成为子树的根 */
+static void rotate_left(struct rb_root *root, struct rb_node *x, rb_augment_fn *augment) {
+    struct rb_node *y = x->right;
+    x->right = y->left;
+    if (y->left != NULL)
+        y->left->parent = x;
+    y->parent = x->parent;
+    replace_child(root, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+    /* 子树整体的成员不变，只需先后更新下移的 x 和上移的 y */
+    if (augment != NULL) {
+        augment(x);
+        augment(y);
+    }
+}
+
+/* rotate_right - 以 x 为支点右旋，x 的左子节点成为子树的根 */
+static void rotate_right(struct rb_root *root, struct rb_node *x, rb_augment_fn *augment) {
+    struct rb_node *y = x->left;
+    x->left = y->right;
+    if (y->right != NULL)
+        y->right->parent = x;
+    y->parent = x->parent;
+    replace_child(root, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+    if (augment != NULL) {
+        augment(x);
+        augment(y);
+    }
+}
+
+/* is_black - NULL 叶子视为黑色 */
+static bool is_black(struct rb_node *node) {
+    return node == NULL || node->color == RB_BLACK;
+}
+
+/**
+ * rb_augment_propagate - 从 node 开始向上直到根节点，依次重新计算增强信息。
+ * @node: 起始节点，可以为 NULL。
+ * @augment: 增强回调，为 NULL 时什么也不做。
+ *
+ * 节点自身的键或附加信息改变后由调用者调用，代价为 O(log n)。
+ */
+void rb_augment_propagate(struct rb_node *node, rb_augment_fn *augment) {
+    if (augment == NULL)
+        return;
+    while (node != NULL) {
+        augment(node);
+        node = node->parent;
+    }
+}
+
+/**
+ * rb_insert_color - 在 rb_link_node 之后恢复红黑树的性质。
+ * @root: 树。
+ * @node: 刚挂上的新节点。
+ * @augment: 增强回调，可以为 NULL。
+ */
+void rb_insert_color(struct rb_root *root, struct rb_node *node, rb_augment_fn *augment) {
+    rb_augment_propagate(node, augment);
+
+    struct rb_node *parent, *gparent, *uncle;
+    while ((parent = node->parent) != NULL && parent->color == RB_RED) {
+        gparent = parent->parent;
+        if (parent == gparent->left) {
+            uncle = gparent->right;
+            if (!is_black(uncle)) {
+                /* 叔节点为红：父、叔变黑，祖父变红，继续向上检查 */
+                parent->color = uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rotate_left(root, parent, augment);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rotate_right(root, gparent, augment);
+        } else {
+            uncle = gparent->left;
+            if (!is_black(uncle)) {
+                parent->color = uncle->color = RB_BLACK;
+                gparent->color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rotate_right(root, parent, augment);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            gparent->color = RB_RED;
+            rotate_left(root, gparent, augment);
+        }
+    }
+    root->node->color = RB_BLACK;
+}
+
+/* erase_fixup - 删除黑色节点后，从 node（可能为 NULL，父节点为 parent）开始恢复黑高 */
+static void erase_fixup(struct rb_root *root, struct rb_node *node, struct rb_node *parent,
+                        rb_augment_fn *augment) {
+    struct rb_node *sibling;
+    while (node != root->node && is_black(node)) {
+        if (node == parent->left) {
+            sibling = parent->right;
+            if (!is_black(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_left(root, parent, augment);
+                sibling = parent->right;
+            }
+            if (is_black(sibling->left) && is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (is_black(sibling->right)) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rotate_right(root, sibling, augment);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rotate_left(root, parent, augment);
+            node = root->node;
+        } else {
+            sibling = parent->left;
+            if (!is_black(sibling)) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rotate_right(root, parent, augment);
+                sibling = parent->left;
+            }
+            if (is_black(sibling->left) && is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (is_black(sibling->left)) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rotate_left(root, sibling, augment);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rotate_right(root, parent, augment);
+            node = root->node;
+        }
+    }
+    if (node != NULL)
+        node->color = RB_BLACK;
+}
+
+/**
+ * rb_erase - 从树中删除节点。
+ * @root: 树。
+ * @node: 要删除的节点。
+ * @augment: 增强回调，可以为 NULL。
+ *
+ * 有两个子节点时用其后继节点顶替它的位置，因此其余节点在树中的相对顺序不变。
+ */
+void rb_erase(struct rb_root *root, struct rb_node *node, rb_augment_fn *augment) {
+    struct rb_node *child, *parent;
+    uint8_t color;
+
+    if (node->left == NULL || node->right == NULL) {
+        child = node->left != NULL ? node->left : node->right;
+        parent = node->parent;
+        color = node->color;
+        replace_child(root, parent, node, child);
+        if (child != NULL)
+            child->parent = parent;
+    } else {
+        struct rb_node *succ = node->right;
+        while (succ->left != NULL)
+            succ = succ->left;
+        child = succ->right;
+        color = succ->color;
+        if (succ->parent == node) {
+            parent = succ;
+        } else {
+            parent = succ->parent;
+            parent->left = child;
+            if (child != NULL)
+                child->parent = parent;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->parent = node->parent;
+        succ->color = node->color;
+        replace_child(root, node->parent, node, succ);
+    }
+
+    /* 从结构发生变化的最低节点向上更新，顶替者 succ 也在这条路径上 */
+    rb_augment_propagate(parent, augment);
+    if (color == RB_BLACK)
+        erase_fixup(root, child, parent, augment);
+}
+
+/* rb_first - 返回树中最小的节点，空树返回 NULL */
+struct rb_node *rb_first(struct rb_root *root) {
+    struct rb_node *node = root->node;
+    if (node == NULL)
+        return NULL;
+    while (node->left != NULL)
+        node = node->left;
+    return node;
+}
+
+/* rb_last - 返回树中最大的节点，空树返回 NULL */
+struct rb_node *rb_last(struct rb_root *root) {
+    struct rb_node *node = root->node;
+    if (node == NULL)
+        return NULL;
+    while (node->right != NULL)
+        node = node->right;
+    return node;
+}
+
+/* rb_next - 返回中序遍历中 node 的后继，没有则返回 NULL */
+struct rb_node *rb_next(struct rb_node *node) {
+    if (node->right != NULL) {
+        node = node->right;
+        while (node->left != NULL)
+            node = node->left;
+        return node;
+    }
+    while (node->parent != NULL && node == node->parent->right)
+        node = node->parent;
+    return node->parent;
+}
+
+/* rb_prev - 返回中序遍历中 node 的前驱，没有则返回 NULL */
+struct rb_node *rb_prev(struct rb_node *node) {
+    if (node->left != NULL) {
+        node = node->left;
+        while (node->right != NULL)
+            node = node->right;
+        return node;
+    }
+    while (node->parent != NULL && node == node->parent->left)
+        node = node->parent;
+    return node->parent;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+#include "global.h"
+#include "stdint.h"
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+/**
+ * struct rb_node - 嵌入在数据结构中的红黑树节点。
+ * @parent: 父节点，根节点为 NULL。
+ * @left: 左子节点。
+ * @right: 右子节点。
+ * @color: 节点颜色，RB_RED 或 RB_BLACK。
+ *
+ * 与 list_elem 一样，通过 elem2entry 由节点得到所在的结构体。
+ * 树只负责平衡，节点的排序由调用者在插入时通过 rb_link_node 决定。
+ */
+struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    uint8_t color;
+};
+
+/* struct rb_root - 红黑树，@node 为根节点，空树时为 NULL */
+struct rb_root {
+    struct rb_node *node;
+};
+
+/*
+ * 增强回调：根据节点自身及其左右子节点重新计算节点上附加的子树信息（如子树最大值）。
+ * 旋转和插入删除时树会在结构发生变化的节点上调用它，不需要时传 NULL。
+ */
+typedef void(rb_augment_fn)(struct rb_node *node);
+
+void rb_root_init(struct rb_root *root);
+void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link);
+void rb_insert_color(struct rb_root *root, struct rb_node *node, rb_augment_fn *augment);
+void rb_erase(struct rb_root *root, struct rb_node *node, rb_augment_fn *augment);
+void rb_augment_propagate(struct rb_node *node, rb_augment_fn *augment);
+struct rb_node *rb_first(struct rb_root *root);
+struct rb_node *rb_last(struct rb_root *root);
+struct rb_node *rb_next(struct rb_node *node);
+struct rb_node *rb_prev(struct rb_node *node);
+
+#endif
\ No newline at end of file
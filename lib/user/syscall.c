@@ -43,4 +43,69 @@ uint32_t getpid() { return _syscall0(SYS_GETPID); }
 /* 从缓冲区将数据写入文件或标准输出 */
 uint32_t write(char* str) {
     return _syscall1(SYS_WRITE, str);
+}
+
+/* 申请 size 字节大小的内存，并返回结果 */
+void *malloc(uint32_t size) {
+    return (void *)_syscall1(SYS_MALLOC, size);
+}
+
+/* 释放 ptr 指向的内存 */
+void free(void *ptr) {
+    _syscall1(SYS_FREE, ptr);
+}
+
+/* 获取内存池和当前进程的内存使用情况 */
+void memstat(struct mem_stat *stat) {
+    _syscall1(SYS_MEMSTAT, stat);
+}
+
+/* 创建 size 字节的共享内存段，返回段的编号 */
+int32_t shm_create(uint32_t size) {
+    return _syscall1(SYS_SHM_CREATE, size);
+}
+
+/* 把编号为 id 的共享内存段映射到当前进程，返回映射的地址 */
+void *shm_attach(int32_t id) {
+    return (void *)_syscall1(SYS_SHM_ATTACH, id);
+}
+
+/* 解除 shm_attach 建立的映射 */
+int32_t shm_detach(void *addr) {
+    return _syscall1(SYS_SHM_DETACH, addr);
+}
+
+/* 复制当前进程，父进程中返回子进程的 pid，子进程中返回 0 */
+int16_t fork(void) {
+    return _syscall0(SYS_FORK);
+}
+
+/* 把进程 pid（0 表示当前进程）改为调度策略 policy，实时策略的优先级为 rt_priority */
+int32_t sched_setscheduler(int16_t pid, enum sched_policy policy, uint8_t rt_priority) {
+    return _syscall3(SYS_SCHED_SETSCHEDULER, pid, policy, rt_priority);
+}
+
+/* 获取进程 pid（0 表示当前进程）从被唤醒到开始运行的延迟统计 */
+int32_t sched_latency(int16_t pid, struct sched_latency *lat) {
+    return _syscall2(SYS_SCHED_LATENCY, pid, lat);
+}
+
+/* 创建每 period_ms 毫秒最多运行 quota_ms 毫秒的任务组，返回组的编号 */
+int32_t tgroup_create(uint32_t quota_ms, uint32_t period_ms) {
+    return _syscall2(SYS_TGROUP_CREATE, quota_ms, period_ms);
+}
+
+/* 把进程 pid（0 表示当前进程）移入任务组 id，id 为 -1 时移出所在的组 */
+int32_t tgroup_attach(int32_t id, int16_t pid) {
+    return _syscall2(SYS_TGROUP_ATTACH, id, pid);
+}
+
+/* 删除没有任务的任务组 id */
+int32_t tgroup_destroy(int32_t id) {
+    return _syscall1(SYS_TGROUP_DESTROY, id);
+}
+
+/* 睡眠至少 m_seconds 毫秒，期间不占用 CPU */
+void msleep(uint32_t m_seconds) {
+    _syscall1(SYS_SLEEP, m_seconds);
 }
\ No newline at end of file
@@ -4,9 +4,95 @@
 
 enum SYSCALL_NR {
     SYS_GETPID,
-    SYS_WRITE
+    SYS_WRITE,
+    SYS_MALLOC,
+    SYS_FREE,
+    SYS_MEMSTAT,
+    SYS_SHM_CREATE,
+    SYS_SHM_ATTACH,
+    SYS_SHM_DETACH,
+    SYS_FORK,
+    SYS_SCHED_SETSCHEDULER,
+    SYS_SCHED_LATENCY,
+    SYS_TGROUP_CREATE,
+    SYS_TGROUP_ATTACH,
+    SYS_TGROUP_DESTROY,
+    SYS_SLEEP
+};
+
+/**
+ * struct mem_stat - 内存使用情况，由 memstat 系统调用填写。
+ * @kernel_free: 内核内存池的空闲页框数。
+ * @kernel_used: 内核内存池已分配的页框数。
+ * @user_free: 用户内存池的空闲页框数。
+ * @user_used: 用户内存池已分配的页框数。
+ * @pt_pages: 所有进程的用户空间页表占用的页框数。
+ * @rss_pages: 当前进程已映射物理页框的页面数。
+ * @reserved_pages: 当前进程预留的用户虚拟页面数。
+ * @swap_pages: 交换区中已换出的页面数。
+ * @zram_pages: 压缩存放在内存中的页面数。
+ * @zram_bytes: 这些页面压缩后的总字节数，与 zram_pages * 4096 之比即压缩率。
+ * @zram_pool_pages: 压缩池占用的内核页面数。
+ * @zram_rejected: 因压缩效果太差而改为换出到硬盘的次数。
+ * @zram_store_cycles: 压缩存入一个页面耗费的 CPU 周期数，取指数滑动平均。
+ * @zram_load_cycles: 解压读回一个页面耗费的 CPU 周期数，取指数滑动平均。
+ */
+struct mem_stat {
+    uint32_t kernel_free;
+    uint32_t kernel_used;
+    uint32_t user_free;
+    uint32_t user_used;
+    uint32_t pt_pages;
+    uint32_t rss_pages;
+    uint32_t reserved_pages;
+    uint32_t swap_pages;
+    uint32_t zram_pages;
+    uint32_t zram_bytes;
+    uint32_t zram_pool_pages;
+    uint32_t zram_rejected;
+    uint32_t zram_store_cycles;
+    uint32_t zram_load_cycles;
+};
+
+/* 调度策略，决定任务所属的调度类 */
+enum sched_policy {
+    SCHED_MLFQ, // 多级反馈队列，适合交互式任务，新任务的默认策略
+    SCHED_FAIR, // 按加权虚拟运行时间公平分配 CPU，适合批处理任务
+    SCHED_FIFO, // 实时，按固定优先级抢占，同优先级先进先出，不分时间片
+    SCHED_RR    // 实时，按固定优先级抢占，同优先级按时间片轮转
+};
+
+/* 实时任务的优先级范围，数值越大越优先 */
+#define RT_PRIO_MIN 1
+#define RT_PRIO_MAX 31
+
+/**
+ * struct sched_latency - 任务从被唤醒到开始运行的延迟，由 sched_latency 系统调用填写。
+ * @wakeups: 被唤醒的次数。
+ * @last_cycles: 最近一次的延迟，单位为 CPU 周期。
+ * @max_cycles: 最大延迟。
+ * @avg_cycles: 延迟的指数滑动平均。
+ */
+struct sched_latency {
+    uint32_t wakeups;
+    uint32_t last_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_cycles;
 };
 
 uint32_t getpid();
 uint32_t write(char* str);
+void *malloc(uint32_t size);
+void free(void *ptr);
+void memstat(struct mem_stat *stat);
+int32_t shm_create(uint32_t size);
+void *shm_attach(int32_t id);
+int32_t shm_detach(void *addr);
+int16_t fork(void);
+int32_t sched_setscheduler(int16_t pid, enum sched_policy policy, uint8_t rt_priority);
+int32_t sched_latency(int16_t pid, struct sched_latency *lat);
+int32_t tgroup_create(uint32_t quota_ms, uint32_t period_ms);
+int32_t tgroup_attach(int32_t id, int16_t pid);
+int32_t tgroup_destroy(int32_t id);
+void msleep(uint32_t m_seconds);
 #endif
\ No newline at end of file
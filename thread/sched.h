@@ -0,0 +1,68 @@
+#ifndef __THREAD_SCHED_H
+#define __THREAD_SCHED_H
+#include "global.h"
+#include "stdint.h"
+#include "syscall.h"
+
+/* 实时调度类中 SCHED_RR 任务的时间片长度（嘀嗒） */
+#define RT_RR_TICKS 10
+
+/* 多级反馈调度类的级数，级别越小越先被调度，优先级为 RUNQ_LEVELS - 1 及以上的任务从第 0 级开始 */
+#define RUNQ_LEVELS 32
+/* 被 I/O 唤醒的任务比初始级别提升的级数 */
+#define RUNQ_IO_BOOST 2
+
+/* 公平调度类中权重为 1 的任务每运行一个嘀嗒，虚拟运行时间增加的量；权重即任务的优先级 */
+#define FAIR_WEIGHT_UNIT 1024
+/* 公平调度类的任务至少连续运行这么多嘀嗒，才会被虚拟运行时间更小的同类任务抢占 */
+#define FAIR_MIN_TICKS 2
+/* 被唤醒的任务的虚拟运行时间最多比就绪任务中的最小值落后这么多，阻塞不能积攒运行时间 */
+#define FAIR_SLEEPER_CREDIT FAIR_WEIGHT_UNIT
+/* 被唤醒的任务的虚拟运行时间比当前任务小这么多以上才立即抢占 */
+#define FAIR_WAKEUP_GRAN (FAIR_WEIGHT_UNIT / 2)
+/* 公平调度类有就绪任务却这么多嘀嗒没有运行时视为饥饿，先于多级反馈调度类选择它 */
+#define FAIR_STARVE_TICKS 20
+/* 因饥饿被选中的公平调度类任务运行这么多嘀嗒后让回，批处理任务至少得到 1/5 的 CPU */
+#define FAIR_SHARE_TICKS 5
+
+struct task_struct;
+
+/* 任务进入就绪队列的原因 */
+enum enqueue_reason {
+    ENQUEUE_NEW,       // 新建的任务，或刚改变调度类的任务
+    ENQUEUE_WAKEUP,    // 阻塞后被唤醒
+    ENQUEUE_WAKEUP_IO, // 等待 I/O 后被唤醒
+    ENQUEUE_PREEMPT,   // 正在运行时因时间片用完或被抢占而换下
+    ENQUEUE_YIELD      // 主动让出 CPU
+};
+
+/**
+ * struct sched_class - 调度类，管理属于它的任务的就绪队列。
+ * @rank: 调度类之间的先后。只要 rank 小的调度类中有就绪任务，就不会选择 rank 大的调度类中的任务；
+ *        唯一的例外是饥饿的公平调度类，见 fair_starving。
+ * @init: 初始化就绪队列。
+ * @enqueue: 把状态为 TASK_READY 的任务放入就绪队列。
+ * @dequeue: 把仍在就绪队列中的任务取出，用于改变任务的调度类。
+ * @pick_next: 取出下一个要运行的任务，没有就绪任务时返回 NULL。
+ * @tick: 时钟中断时为正在运行的任务计时，返回 true 表示应当重新调度。
+ * @check_preempt: 同一调度类的任务 woken 被唤醒后，是否应当抢占正在运行的 cur。
+ *
+ * 除 init 外的回调都在关中断的情况下调用。
+ */
+struct sched_class {
+    uint8_t rank;
+    void (*init)(void);
+    void (*enqueue)(struct task_struct *pthread, enum enqueue_reason reason);
+    void (*dequeue)(struct task_struct *pthread);
+    struct task_struct *(*pick_next)(void);
+    bool (*tick)(struct task_struct *pthread);
+    bool (*check_preempt)(struct task_struct *cur, struct task_struct *woken);
+};
+
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class mlfq_sched_class;
+extern const struct sched_class fair_sched_class;
+
+bool fair_starving(void);
+struct task_struct *fair_pick_starving(void);
+#endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "sched.h"
+#include "debug.h"
+#include "interrupt.h"
+#include "rbtree.h"
+#include "thread.h"
+#include "timer.h"
+
+/*
+ * 就绪任务按虚拟运行时间排序在红黑树中，最左节点另行缓存，正在运行的任务不在树中。
+ * 任务每运行一个嘀嗒，虚拟运行时间增加 FAIR_WEIGHT_UNIT / 权重，权重即任务的优先级，
+ * 总是运行虚拟运行时间最小的任务，各任务得到的 CPU 时间因此与优先级成正比。
+ */
+static struct rb_root fair_tree;
+static struct rb_node *fair_leftmost;
+/* 就绪及正在运行的任务中最小的虚拟运行时间，只增不减 */
+static uint64_t min_vruntime;
+/* 就绪任务从这个全局 ticks 起一直没有轮到公平调度类运行 */
+static uint32_t fair_wait_start;
+/* 正在运行的任务是因饥饿被选中的，运行 FAIR_SHARE_TICKS 后让回 */
+static bool fair_boosted;
+
+/* node2task - 由红黑树节点得到任务 */
+static struct task_struct *node2task(struct rb_node *node) {
+    return elem2entry(struct task_struct, fair_node, node);
+}
+
+/* vruntime_before - 虚拟运行时间 a 是否小于 b，允许回绕 */
+static bool vruntime_before(uint64_t a, uint64_t b) {
+    return (int64_t)(a - b) < 0;
+}
+
+/* fair_weight - 任务的权重，优先级为0的任务按1计 */
+static uint32_t fair_weight(struct task_struct *pthread) {
+    return pthread->priority > 0 ? pthread->priority : 1;
+}
+
+/* vruntime_update - 把任务上次结算以来运行的嘀嗒数按权重折算进虚拟运行时间 */
+static void vruntime_update(struct task_struct *pthread) {
+    uint32_t delta = pthread->elapsed_ticks - pthread->fair_seen_ticks;
+    pthread->fair_seen_ticks = pthread->elapsed_ticks;
+    pthread->vruntime += delta * FAIR_WEIGHT_UNIT / fair_weight(pthread);
+}
+
+/* min_vruntime_update - 用正在运行的任务 cur（可以为 NULL）和最左节点推进 min_vruntime */
+static void min_vruntime_update(struct task_struct *cur) {
+    uint64_t vruntime;
+    if (fair_leftmost != NULL) {
+        vruntime = node2task(fair_leftmost)->vruntime;
+        if (cur != NULL && vruntime_before(cur->vruntime, vruntime))
+            vruntime = cur->vruntime;
+    } else if (cur != NULL) {
+        vruntime = cur->vruntime;
+    } else {
+        return;
+    }
+    if (vruntime_before(min_vruntime, vruntime))
+        min_vruntime = vruntime;
+}
+
+static void fair_init(void) {
+    rb_root_init(&fair_tree);
+    fair_leftmost = NULL;
+    min_vruntime = 0;
+    fair_wait_start = 0;
+    fair_boosted = false;
+}
+
+/**
+ * fair_enqueue - 结算任务的虚拟运行时间并插入红黑树
+ * @pthread: 就绪的任务
+ * @reason: 进入就绪队列的原因
+ *
+ * 新任务从 min_vruntime 开始，不能靠较小的初值长期占用 CPU。被唤醒的任务最多落后 min_vruntime
+ * FAIR_SLEEPER_CREDIT，因此无论任务如何阻塞，各任务得到的 CPU 时间仍与权重成正比。
+ * 虚拟运行时间相同的任务排在已有任务之后。
+ */
+static void fair_enqueue(struct task_struct *pthread, enum enqueue_reason reason) {
+    uint64_t floor;
+    switch (reason) {
+    case ENQUEUE_NEW:
+        if (vruntime_before(pthread->vruntime, min_vruntime))
+            pthread->vruntime = min_vruntime;
+        pthread->fair_seen_ticks = pthread->elapsed_ticks;
+        break;
+    case ENQUEUE_WAKEUP:
+    case ENQUEUE_WAKEUP_IO:
+        floor = min_vruntime - FAIR_SLEEPER_CREDIT;
+        if (vruntime_before(pthread->vruntime, floor))
+            pthread->vruntime = floor;
+        pthread->fair_seen_ticks = pthread->elapsed_ticks;
+        break;
+    case ENQUEUE_PREEMPT:
+    case ENQUEUE_YIELD:
+        vruntime_update(pthread);
+        break;
+    }
+
+    if (fair_leftmost == NULL)
+        fair_wait_start = ticks;
+    struct rb_node **link = &fair_tree.node, *parent = NULL;
+    bool leftmost = true;
+    while (*link != NULL) {
+        parent = *link;
+        if (vruntime_before(pthread->vruntime, node2task(parent)->vruntime)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = false;
+        }
+    }
+    rb_link_node(&pthread->fair_node, parent, link);
+    rb_insert_color(&fair_tree, &pthread->fair_node, NULL);
+    if (leftmost)
+        fair_leftmost = &pthread->fair_node;
+}
+
+/* fair_dequeue - 把就绪任务从红黑树中取出 */
+static void fair_dequeue(struct task_struct *pthread) {
+    if (fair_leftmost == &pthread->fair_node)
+        fair_leftmost = rb_next(fair_leftmost);
+    rb_erase(&fair_tree, &pthread->fair_node, NULL);
+}
+
+/* fair_pick_next - 取虚拟运行时间最小的任务 */
+static struct task_struct *fair_pick_next(void) {
+    if (fair_leftmost == NULL)
+        return NULL;
+    struct task_struct *next = node2task(fair_leftmost);
+    fair_dequeue(next);
+    next->fair_start_ticks = next->elapsed_ticks;
+    min_vruntime_update(next);
+    fair_wait_start = ticks;
+    fair_boosted = false;
+    return next;
+}
+
+/**
+ * fair_starving - 公平调度类的就绪任务是否已经 FAIR_STARVE_TICKS 个嘀嗒没有轮到运行
+ *
+ * 多级反馈调度类的 rank 更小，其中只要有计算密集型任务，公平调度类就永远得不到 CPU。
+ * 饥饿时多级反馈调度类让出时间片，由 fair_pick_starving 先选公平调度类的任务。
+ */
+bool fair_starving(void) {
+    return fair_leftmost != NULL && ticks - fair_wait_start >= FAIR_STARVE_TICKS;
+}
+
+/* fair_pick_starving - 因饥饿选出公平调度类的任务，它只运行 FAIR_SHARE_TICKS 个嘀嗒 */
+struct task_struct *fair_pick_starving(void) {
+    struct task_struct *next = fair_pick_next();
+    fair_boosted = next != NULL;
+    return next;
+}
+
+/**
+ * fair_tick - 结算正在运行的任务的虚拟运行时间
+ * @pthread: 正在运行的任务
+ *
+ * 任务至少连续运行 FAIR_MIN_TICKS 个嘀嗒后，若已有就绪任务的虚拟运行时间比它小，就要求重新调度。
+ * 因饥饿被选中的任务运行 FAIR_SHARE_TICKS 个嘀嗒后也要求重新调度，把 CPU 还给 rank 更小的调度类。
+ */
+static bool fair_tick(struct task_struct *pthread) {
+    vruntime_update(pthread);
+    min_vruntime_update(pthread);
+    fair_wait_start = ticks;
+    if (fair_boosted && pthread->elapsed_ticks - pthread->fair_start_ticks >= FAIR_SHARE_TICKS) {
+        fair_boosted = false;
+        return true;
+    }
+    if (pthread->elapsed_ticks - pthread->fair_start_ticks < FAIR_MIN_TICKS)
+        return false;
+    return fair_leftmost != NULL && vruntime_before(node2task(fair_leftmost)->vruntime, pthread->vruntime);
+}
+
+/* fair_check_preempt - 被唤醒的任务的虚拟运行时间明显更小时抢占 */
+static bool fair_check_preempt(struct task_struct *cur, struct task_struct *woken) {
+    vruntime_update(cur);
+    return vruntime_before(woken->vruntime + FAIR_WAKEUP_GRAN, cur->vruntime);
+}
+
+const struct sched_class fair_sched_class = {
+    .rank = 2,
+    .init = fair_init,
+    .enqueue = fair_enqueue,
+    .dequeue = fair_dequeue,
+    .pick_next = fair_pick_next,
+    .tick = fair_tick,
+    .check_preempt = fair_check_preempt,
+};
\ No newline at end of file
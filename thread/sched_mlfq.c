@@ -0,0 +1,138 @@
+#include "sched.h"
+#include "bitops.h"
+#include "debug.h"
+#include "interrupt.h"
+#include "list.h"
+#include "thread.h"
+
+/**
+ * struct runqueue - 多级就绪队列
+ * @bitmap: 第 i 位为 1 表示第 i 级队列非空
+ * @queues: 每一级一个先进先出队列
+ *
+ * 用 bsf 找到 bitmap 中最低的置1位即得到最高的非空级别，选出下一个任务的开销与任务数无关。
+ */
+struct runqueue {
+    uint32_t bitmap;
+    struct list queues[RUNQ_LEVELS];
+};
+
+/*
+ * 活动队列和过期队列。用完时间片的任务进入过期队列，活动队列为空时两者互换，
+ * 因此每个就绪任务在一轮中至少运行一次，低优先级任务不会饿死。
+ * 新建和被唤醒的任务进入活动队列，级别高的可以在本轮中抢在用完时间片的任务之前运行。
+ */
+static struct runqueue runqueues[2];
+static struct runqueue *active_rq = &runqueues[0], *expired_rq = &runqueues[1];
+
+/* base_level - 优先级为 priority 的任务的初始级别 */
+static uint8_t base_level(uint8_t priority) {
+    return priority >= RUNQ_LEVELS - 1 ? 0 : RUNQ_LEVELS - 1 - priority;
+}
+
+/* runq_append - 把任务 pthread 加到 rq 中其级别对应队列的队尾 */
+static void runq_append(struct runqueue *rq, struct task_struct *pthread) {
+    ASSERT(intr_get_status() == INTR_OFF && pthread->level < RUNQ_LEVELS);
+    list_append(&rq->queues[pthread->level], &pthread->general_tag);
+    rq->bitmap |= 1 << pthread->level;
+}
+
+/* runq_pop - 取出 rq 中级别最高的队列的队首任务，rq 不能为空 */
+static struct task_struct *runq_pop(struct runqueue *rq) {
+    uint32_t level = bit_scan_forward(rq->bitmap);
+    struct list_elem *thread_tag = list_pop(&rq->queues[level]);
+    if (list_empty(&rq->queues[level]))
+        rq->bitmap &= ~(1 << level);
+    return elem2entry(struct task_struct, general_tag, thread_tag);
+}
+
+static void mlfq_init(void) {
+    uint32_t level;
+    for (level = 0; level < RUNQ_LEVELS; level++) {
+        list_init(&runqueues[0].queues[level]);
+        list_init(&runqueues[1].queues[level]);
+    }
+}
+
+/**
+ * mlfq_enqueue - 按任务进入就绪队列的原因决定它的级别和队列
+ * @pthread: 就绪的任务
+ * @reason: 进入就绪队列的原因
+ *
+ * 新建和被唤醒的任务回到初始级别，被 I/O 唤醒的再提升 RUNQ_IO_BOOST 级，都进入活动队列。
+ * 用完时间片的任务降一级并进入过期队列，时间片重新装满；被抢占的留在活动队列中本级别的队尾。
+ * 主动让出 CPU 的任务进入过期队列，本轮中其他就绪任务都运行过之后才会再次运行。
+ */
+static void mlfq_enqueue(struct task_struct *pthread, enum enqueue_reason reason) {
+    uint8_t level = base_level(pthread->priority);
+    switch (reason) {
+    case ENQUEUE_NEW:
+    case ENQUEUE_WAKEUP:
+        pthread->level = level;
+        runq_append(active_rq, pthread);
+        break;
+    case ENQUEUE_WAKEUP_IO:
+        pthread->level = level > RUNQ_IO_BOOST ? level - RUNQ_IO_BOOST : 0;
+        runq_append(active_rq, pthread);
+        break;
+    case ENQUEUE_PREEMPT:
+        if (pthread->ticks == 0) {
+            /* 时间片用完，说明是计算密集型任务，降一级 */
+            if (pthread->level < RUNQ_LEVELS - 1)
+                pthread->level++;
+            pthread->ticks = pthread->priority;
+            runq_append(expired_rq, pthread);
+        } else {
+            runq_append(active_rq, pthread);
+        }
+        break;
+    case ENQUEUE_YIELD:
+        runq_append(expired_rq, pthread);
+        break;
+    }
+}
+
+/* mlfq_dequeue - 把就绪任务从所在的队列中取出 */
+static void mlfq_dequeue(struct task_struct *pthread) {
+    list_remove(&pthread->general_tag);
+    uint32_t i;
+    for (i = 0; i < 2; i++) {
+        if (list_empty(&runqueues[i].queues[pthread->level]))
+            runqueues[i].bitmap &= ~(1 << pthread->level);
+    }
+}
+
+/* mlfq_pick_next - 取活动队列中级别最高的任务，活动队列为空时先与过期队列互换 */
+static struct task_struct *mlfq_pick_next(void) {
+    if (active_rq->bitmap == 0) {
+        struct runqueue *rq = active_rq;
+        active_rq = expired_rq;
+        expired_rq = rq;
+    }
+    if (active_rq->bitmap == 0)
+        return NULL;
+    return runq_pop(active_rq);
+}
+
+/* mlfq_tick - 时间片用完，或公平调度类饥饿时要求重新调度 */
+static bool mlfq_tick(struct task_struct *pthread) {
+    if (pthread->ticks == 0)
+        return true;
+    pthread->ticks--;
+    return fair_starving();
+}
+
+/* mlfq_check_preempt - 被唤醒的任务级别更高时抢占 */
+static bool mlfq_check_preempt(struct task_struct *cur, struct task_struct *woken) {
+    return woken->level < cur->level;
+}
+
+const struct sched_class mlfq_sched_class = {
+    .rank = 1,
+    .init = mlfq_init,
+    .enqueue = mlfq_enqueue,
+    .dequeue = mlfq_dequeue,
+    .pick_next = mlfq_pick_next,
+    .tick = mlfq_tick,
+    .check_preempt = mlfq_check_preempt,
+};
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "sched.h"
+#include "bitops.h"
+#include "debug.h"
+#include "interrupt.h"
+#include "list.h"
+#include "thread.h"
+
+/*
+ * 实时调度类的就绪队列：每个实时优先级一个先进先出队列，第 i 位为 1 表示优先级 RT_PRIO_MAX - i 的队列非空，
+ * 用 bsf 即可找到优先级最高的非空队列。实时调度类排在所有调度类之前，只要有就绪的实时任务，
+ * 其他调度类的任务就不会运行。
+ */
+static uint32_t rt_bitmap;
+static struct list rt_queues[RT_PRIO_MAX + 1];
+
+static void rt_init(void) {
+    uint32_t idx;
+    for (idx = 0; idx <= RT_PRIO_MAX; idx++)
+        list_init(&rt_queues[idx]);
+}
+
+/**
+ * rt_enqueue - 把实时任务放入其优先级的队列
+ * @pthread: 就绪的实时任务
+ * @reason: 进入就绪队列的原因
+ *
+ * 被更高优先级任务抢占的任务回到队首，恢复后接着运行；SCHED_RR 任务用完时间片、
+ * 以及新建、被唤醒和主动让出的任务排到队尾。
+ */
+static void rt_enqueue(struct task_struct *pthread, enum enqueue_reason reason) {
+    ASSERT(pthread->rt_priority >= RT_PRIO_MIN && pthread->rt_priority <= RT_PRIO_MAX);
+    uint32_t idx = RT_PRIO_MAX - pthread->rt_priority;
+    if (reason == ENQUEUE_NEW && pthread->policy == SCHED_RR)
+        pthread->ticks = RT_RR_TICKS;
+
+    if (reason == ENQUEUE_PREEMPT && (pthread->policy == SCHED_FIFO || pthread->ticks > 0)) {
+        list_push(&rt_queues[idx], &pthread->general_tag);
+    } else {
+        if (reason == ENQUEUE_PREEMPT)
+            pthread->ticks = RT_RR_TICKS;
+        list_append(&rt_queues[idx], &pthread->general_tag);
+    }
+    rt_bitmap |= 1 << idx;
+}
+
+/* rt_dequeue - 把就绪的实时任务从队列中取出 */
+static void rt_dequeue(struct task_struct *pthread) {
+    uint32_t idx = RT_PRIO_MAX - pthread->rt_priority;
+    list_remove(&pthread->general_tag);
+    if (list_empty(&rt_queues[idx]))
+        rt_bitmap &= ~(1 << idx);
+}
+
+/* rt_pick_next - 取优先级最高的队列的队首任务 */
+static struct task_struct *rt_pick_next(void) {
+    if (rt_bitmap == 0)
+        return NULL;
+    uint32_t idx = bit_scan_forward(rt_bitmap);
+    struct list_elem *thread_tag = list_pop(&rt_queues[idx]);
+    if (list_empty(&rt_queues[idx]))
+        rt_bitmap &= ~(1 << idx);
+    return elem2entry(struct task_struct, general_tag, thread_tag);
+}
+
+/* rt_tick - SCHED_FIFO 任务一直运行到阻塞或让出，SCHED_RR 任务用完时间片时轮转 */
+static bool rt_tick(struct task_struct *pthread) {
+    if (pthread->policy == SCHED_FIFO)
+        return false;
+    if (pthread->ticks == 0)
+        return true;
+    pthread->ticks--;
+    return false;
+}
+
+/* rt_check_preempt - 被唤醒的任务优先级更高时抢占 */
+static bool rt_check_preempt(struct task_struct *cur, struct task_struct *woken) {
+    return woken->rt_priority > cur->rt_priority;
+}
+
+const struct sched_class rt_sched_class = {
+    .rank = 0,
+    .init = rt_init,
+    .enqueue = rt_enqueue,
+    .dequeue = rt_dequeue,
+    .pick_next = rt_pick_next,
+    .tick = rt_tick,
+    .check_preempt = rt_check_preempt,
+};
\ No newline at end of file
@@ -67,14 +67,14 @@ void sema_up(struct semaphore *psema) {
     enum intr_status old_status = intr_disable();
     ASSERT(psema->value == 0);
 
+    /* 先增加值再唤醒：被唤醒的实时线程会立即运行，它醒来时必须能看到信号量可用 */
+    psema->value++;
     if (!list_empty(&psema->waiters)) {
         struct list_elem *blocked_thread_tag = list_pop(&psema->waiters);
         struct task_struct *blocked_thread =
             elem2entry(struct task_struct, general_tag, blocked_thread_tag);
         thread_unblock(blocked_thread);
     }
-    psema->value++;
-    ASSERT(psema->value == 1);
     intr_set_status(old_status);
 }
 
@@ -0,0 +1,211 @@
+#include "task_group.h"
+#include "debug.h"
+#include "interrupt.h"
+#include "print.h"
+#include "sched.h"
+#include "thread.h"
+#include "timer.h"
+
+/*
+ * 任务组限制组中任务合计的 CPU 时间：每 period_ticks 个嘀嗒最多运行 quota_ticks 个。
+ * 时钟中断为当前任务所在的组计时，配额用完后组被节流，组中的任务被调度选中时暂存到组的
+ * throttled_list 中而不运行，下一个周期开始时再全部放回各自调度类的就绪队列。
+ * 不属于任何组的任务不受限制。所有数据都在关中断时访问。
+ */
+static struct task_group groups[TASK_GROUP_MAX];
+
+/* task_group_init - 初始化任务组表 */
+void task_group_init(void) {
+    put_str("  task_group_init start\n");
+    uint32_t id;
+    for (id = 0; id < TASK_GROUP_MAX; id++) {
+        groups[id].used = false;
+        list_init(&groups[id].throttled_list);
+    }
+    put_str("  task_group_init done\n");
+}
+
+/* group_unthrottle - 解除组的节流，暂存的任务放回各自调度类的就绪队列 */
+static void group_unthrottle(struct task_group *group) {
+    group->throttled = false;
+    while (!list_empty(&group->throttled_list)) {
+        struct list_elem *tag = list_pop(&group->throttled_list);
+        struct task_struct *pthread = elem2entry(struct task_struct, general_tag, tag);
+        pthread->throttled = false;
+        pthread->sched_class->enqueue(pthread, ENQUEUE_WAKEUP);
+        need_resched = true;
+    }
+}
+
+/**
+ * task_group_tick - 时钟中断时为任务组计时
+ * @cur: 正在运行的任务
+ *
+ * 先为各组开始新的周期，必要时解除节流；再把这个嘀嗒计入 cur 所在的组。
+ *
+ * 返回值: cur 所在的组在这个嘀嗒用完了配额，需要重新调度时返回 true。
+ */
+bool task_group_tick(struct task_struct *cur) {
+    ASSERT(intr_get_status() == INTR_OFF);
+    uint32_t id;
+    for (id = 0; id < TASK_GROUP_MAX; id++) {
+        struct task_group *group = &groups[id];
+        if (group->used && ticks - group->period_start >= group->period_ticks) {
+            group->period_start = ticks;
+            group->runtime = 0;
+            if (group->throttled)
+                group_unthrottle(group);
+        }
+    }
+
+    struct task_group *group = cur->group;
+    if (group == NULL)
+        return false;
+    group->runtime++;
+    if (group->runtime >= group->quota_ticks && !group->throttled) {
+        group->throttled = true;
+        return true;
+    }
+    return group->throttled;
+}
+
+/**
+ * task_group_park - 调度选中的任务所在的组已被节流时，把任务暂存到组中
+ * @pthread: 刚从调度类中取出的任务
+ *
+ * 返回值: 任务被暂存、不能运行时返回 true。
+ */
+bool task_group_park(struct task_struct *pthread) {
+    if (pthread->group == NULL || !pthread->group->throttled)
+        return false;
+    pthread->throttled = true;
+    list_append(&pthread->group->throttled_list, &pthread->general_tag);
+    return true;
+}
+
+/**
+ * task_group_next_period - 空闲时计算最早的被节流的组还要多少个嘀嗒开始新的周期
+ *
+ * 空闲任务据此设置单次定时，被节流的任务能按时回到就绪队列。
+ *
+ * 返回值: 嘀嗒数，没有被节流的组时返回 0xffffffff。
+ */
+uint32_t task_group_next_period(void) {
+    uint32_t next = 0xffffffff;
+    uint32_t id;
+    for (id = 0; id < TASK_GROUP_MAX; id++) {
+        struct task_group *group = &groups[id];
+        if (!group->used || !group->throttled)
+            continue;
+        uint32_t passed = ticks - group->period_start;
+        uint32_t left = passed >= group->period_ticks ? 0 : group->period_ticks - passed;
+        if (left < next)
+            next = left;
+    }
+    return next;
+}
+
+/* task_group_fork - fork 出的子进程与父进程属于同一个组，在 fork 确定成功之后调用 */
+void task_group_fork(struct task_struct *child) {
+    enum intr_status old_status = intr_disable();
+    /* 复制 PCB 之后父进程可能已被移到别的组，以它此刻所在的组为准 */
+    child->group = running_thread()->group;
+    child->throttled = false;
+    if (child->group != NULL)
+        child->group->nr_tasks++;
+    intr_set_status(old_status);
+}
+
+/**
+ * sys_tgroup_create - 创建一个任务组
+ * @quota_ms: 每个周期内组中任务合计最多运行的毫秒数
+ * @period_ms: 周期的毫秒数
+ *
+ * 两者都向上取整到嘀嗒（MS_PER_TICK 毫秒），配额不能超过周期。
+ *
+ * 返回值: 组的编号，参数无效或组已满时返回 -1。
+ */
+int32_t sys_tgroup_create(uint32_t quota_ms, uint32_t period_ms) {
+    uint32_t quota_ticks = DIV_ROUND_UP(quota_ms, MS_PER_TICK);
+    uint32_t period_ticks = DIV_ROUND_UP(period_ms, MS_PER_TICK);
+    if (quota_ticks == 0 || quota_ticks > period_ticks)
+        return -1;
+
+    enum intr_status old_status = intr_disable();
+    int32_t id;
+    for (id = 0; id < TASK_GROUP_MAX && groups[id].used; id++)
+        ;
+    if (id == TASK_GROUP_MAX) {
+        intr_set_status(old_status);
+        return -1;
+    }
+    struct task_group *group = &groups[id];
+    group->used = true;
+    group->quota_ticks = quota_ticks;
+    group->period_ticks = period_ticks;
+    group->period_start = ticks;
+    group->runtime = 0;
+    group->throttled = false;
+    group->nr_tasks = 0;
+    intr_set_status(old_status);
+    return id;
+}
+
+/**
+ * sys_tgroup_attach - 把任务 pid 移入任务组 id
+ * @id: 组的编号，-1 表示移出所在的组，不再受限制
+ * @pid: 任务的 pid，0 表示当前任务
+ *
+ * 被原来的组暂存的任务放回就绪队列，新组已被节流时它会在下次被选中时暂存到新组中。
+ *
+ * 返回值: 成功返回 0，组或任务不存在、或 pid 是空闲任务时返回 -1。
+ */
+int32_t sys_tgroup_attach(int32_t id, int16_t pid) {
+    if (id < -1 || id >= TASK_GROUP_MAX)
+        return -1;
+    struct task_struct *pthread = pid2task(pid);
+    if (pthread == NULL || pthread == idle_thread)
+        return -1;
+
+    enum intr_status old_status = intr_disable();
+    struct task_group *group = id == -1 ? NULL : &groups[id];
+    if (group != NULL && !group->used) {
+        intr_set_status(old_status);
+        return -1;
+    }
+    if (pthread->group != NULL)
+        pthread->group->nr_tasks--;
+    if (pthread->throttled) {
+        list_remove(&pthread->general_tag);
+        pthread->throttled = false;
+        pthread->sched_class->enqueue(pthread, ENQUEUE_WAKEUP);
+    }
+    pthread->group = group;
+    if (group != NULL)
+        group->nr_tasks++;
+    if (pthread == running_thread() && group != NULL && group->throttled)
+        need_resched = true;
+    intr_set_status(old_status);
+    return 0;
+}
+
+/**
+ * sys_tgroup_destroy - 删除任务组 id
+ * @id: 组的编号
+ *
+ * 返回值: 成功返回 0，组不存在或仍有任务时返回 -1。
+ */
+int32_t sys_tgroup_destroy(int32_t id) {
+    if (id < 0 || id >= TASK_GROUP_MAX)
+        return -1;
+    enum intr_status old_status = intr_disable();
+    struct task_group *group = &groups[id];
+    if (!group->used || group->nr_tasks > 0) {
+        intr_set_status(old_status);
+        return -1;
+    }
+    ASSERT(list_empty(&group->throttled_list));
+    group->used = false;
+    intr_set_status(old_status);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef __THREAD_TASK_GROUP_H
+#define __THREAD_TASK_GROUP_H
+#include "global.h"
+#include "list.h"
+#include "stdint.h"
+
+/* 任务组的最大个数 */
+#define TASK_GROUP_MAX 8
+
+struct task_struct;
+
+/**
+ * struct task_group - 共享 CPU 配额的一组任务
+ * @used: 该槽位是否已被占用
+ * @quota_ticks: 每个周期内组中所有任务合计最多运行的嘀嗒数
+ * @period_ticks: 周期的长度（嘀嗒）
+ * @period_start: 当前周期开始时的全局 ticks
+ * @runtime: 当前周期内已经运行的嘀嗒数
+ * @throttled: 本周期的配额已经用完
+ * @throttled_list: 配额用完后轮到运行的就绪任务暂存在这里，不在任何调度类的就绪队列中
+ * @nr_tasks: 组中的任务数
+ */
+struct task_group {
+    bool used;
+    uint32_t quota_ticks;
+    uint32_t period_ticks;
+    uint32_t period_start;
+    uint32_t runtime;
+    bool throttled;
+    struct list throttled_list;
+    uint32_t nr_tasks;
+};
+
+void task_group_init(void);
+bool task_group_tick(struct task_struct *cur);
+bool task_group_park(struct task_struct *pthread);
+uint32_t task_group_next_period(void);
+void task_group_fork(struct task_struct *child);
+int32_t sys_tgroup_create(uint32_t quota_ms, uint32_t period_ms);
+int32_t sys_tgroup_attach(int32_t id, int16_t pid);
+int32_t sys_tgroup_destroy(int32_t id);
+#endif
\ No newline at end of file
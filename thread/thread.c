@@ -10,12 +10,21 @@
 #include "list.h"
 #include "process.h"
 #include "sync.h"
+#include "io.h"
+#include "timer.h"
 
 #define PAGE_SIZE 4096
 
 struct task_struct *main_thread;       //主线程PCB
-struct list thread_ready_list;         //就绪队列
+struct task_struct *idle_thread;       //空闲任务PCB
 struct list thread_all_list;           //所有任务队列
+
+/* 按 rank 排列的调度类 */
+static const struct sched_class *sched_classes[] = {&rt_sched_class, &mlfq_sched_class, &fair_sched_class};
+#define SCHED_CLASS_CNT (sizeof(sched_classes) / sizeof(sched_classes[0]))
+
+/* 被唤醒的任务应当抢占当前任务，下一个时钟中断时重新调度 */
+bool need_resched;
 //static struct list_elem* thread_tag;   //保存队列中的线程节点
 struct lock pid_lock;
 
@@ -36,6 +45,22 @@ static pid_t allocate_pid() {
     return next_pid;
 }
 
+/* fork_pid - 为 fork 出的子进程分配 pid */
+pid_t fork_pid(void) {
+    return allocate_pid();
+}
+
+/**
+ * thread_ready_add - 把新建的任务放入就绪队列
+ * @pthread: 状态为 TASK_READY、尚未进入任何队列的任务
+ */
+void thread_ready_add(struct task_struct *pthread) {
+    enum intr_status old_status = intr_disable();
+    ASSERT(pthread->status == TASK_READY);
+    pthread->sched_class->enqueue(pthread, ENQUEUE_NEW);
+    intr_set_status(old_status);
+}
+
 /* 关闭中断，执行函数function(func_arg) */
 static void kernel_thread(thread_func *function, void *func_arg) {
     intr_enable();
@@ -84,10 +109,14 @@ void init_thread(struct task_struct *thread, char *name, int _priority) {
     thread->priority = _priority;
     /* 优先级越大，时间片越长 */
     thread->ticks = _priority;
+    thread->sched_class = &mlfq_sched_class;
+    thread->policy = SCHED_MLFQ;
     thread->elapsed_ticks = 0;
     thread->pg_dir = NULL;
+    thread->pg_dir_phy = KERNEL_PAGE_DIR_PHY;
+    thread->rss_pages = 0;
 
-    thread->stack_magic = 0x20030807;
+    thread->stack_magic = STACK_MAGIC;
 }
 
 /*
@@ -98,8 +127,7 @@ struct task_struct *thread_start(char *name, int _priority,thread_func function,
     init_thread(thread, name, _priority);
     thread_create(thread, function, func_arg);
 
-    ASSERT(!list_elem_find(&thread_ready_list, &thread->general_tag));
-    list_append(&thread_ready_list, &thread->general_tag);
+    thread_ready_add(thread);
     ASSERT(!list_elem_find(&thread_all_list, &thread->all_list_tag));
     list_append(&thread_all_list, &thread->all_list_tag);
     
@@ -118,13 +146,47 @@ static void make_main_thread(void) {
     list_append(&thread_all_list, &main_thread->all_list_tag);
 }
 
+/* latency_record - 把一次从唤醒到运行的延迟计入统计，平均值取 1/8 权重的指数滑动平均 */
+static void latency_record(struct sched_latency *lat, uint64_t cycles) {
+    uint32_t sample = cycles > 0xffffffff ? 0xffffffff : (uint32_t)cycles;
+    lat->last_cycles = sample;
+    if (sample > lat->max_cycles)
+        lat->max_cycles = sample;
+    if (lat->wakeups == 0)
+        lat->avg_cycles = sample;
+    else
+        lat->avg_cycles = lat->avg_cycles - (lat->avg_cycles >> 3) + (sample >> 3);
+    lat->wakeups++;
+}
+
+/**
+ * pick_next_task - 按 rank 依次询问各调度类，选出下一个要运行的任务
+ *
+ * 公平调度类饥饿时排在多级反馈调度类之前，批处理任务不会被计算密集型的交互任务永远饿死。
+ * 所在任务组已用完配额的任务暂存到组中，继续选择；没有可以运行的任务时选择空闲任务。
+ */
+static struct task_struct *pick_next_task(void) {
+    while (1) {
+        struct task_struct *next = NULL;
+        uint32_t i;
+        for (i = 0; i < SCHED_CLASS_CNT && next == NULL; i++) {
+            if (sched_classes[i] == &mlfq_sched_class && fair_starving())
+                next = fair_pick_starving();
+            if (next == NULL)
+                next = sched_classes[i]->pick_next();
+        }
+        if (next == NULL)
+            return idle_thread;
+        if (!task_group_park(next))
+            return next;
+    }
+}
+
 /**
- * schedule - 使用先进先出调度选择下一个要运行的线程
+ * schedule - 选择下一个要运行的线程
  *
- * 从就绪列表中选择下一个要运行的任务并切换上下文到它。如果当前运行的线程
- * 已经用完了它的时间片或者正在等待，则将其追加回就绪列表以供稍后调度。
- * 在弹出一个任务之前，该函数确保就绪列表不为空，并确保当前线程在运行时
- * 不在就绪列表中。
+ * 当前线程若仍处于运行状态，说明是时间片用完、被抢占或所在任务组用完了配额，交给它的调度类放回就绪队列；
+ * 阻塞、让出等情况由调用者处理。空闲任务被切换走时让定时器回到周期模式。然后由 pick_next_task 选出下一个任务。
  *
  * 上下文切换到下一个任务，并相应地更新当前任务和下一个任务的状态。
  */
@@ -133,27 +195,26 @@ void schedule() {
 
     struct task_struct *cur_thread = running_thread();
 
-    if (cur_thread->status == TASK_RUNNING) {
-        /* 当前线程的时间片已经用完，加到就绪队列队尾 */
-
-        /* 确保 cur_thread 不在 thread_ready_list 中 */
-        ASSERT(!list_elem_find(&thread_ready_list, &cur_thread->general_tag));
-
-        list_append(&thread_ready_list, &cur_thread->general_tag);
-        cur_thread->ticks = cur_thread->priority;
+    if (cur_thread == idle_thread) {
+        /* 空闲任务不进入就绪队列，被抢占时同样视为阻塞 */
+        timer_idle_exit();
+        if (cur_thread->status == TASK_RUNNING)
+            cur_thread->status = TASK_BLOCKED;
+    } else if (cur_thread->status == TASK_RUNNING) {
         cur_thread->status = TASK_READY;
+        cur_thread->sched_class->enqueue(cur_thread, ENQUEUE_PREEMPT);
     } else {
         /* 其他事件，如线程阻塞、线程让出 */
     }
+    need_resched = false;
 
-    ASSERT(!list_empty(&thread_ready_list));
-
-    struct list_elem* thread_tag;
-    //thread_tag = NULL;
-    thread_tag = list_pop(&thread_ready_list);
-    /* 根据 general_tag 获取 PCB 的起始地址 */
-    struct task_struct *next = elem2entry(struct task_struct, general_tag, thread_tag);
+    struct task_struct *next = pick_next_task();
+    ASSERT(next != NULL);
     next->status = TASK_RUNNING;
+    if (next->wakeup_tsc != 0) {
+        latency_record(&next->latency, rdtsc() - next->wakeup_tsc);
+        next->wakeup_tsc = 0;
+    }
     /* 更新 tss  */
     process_activate(next);
     switch_to(cur_thread, next);
@@ -176,6 +237,35 @@ void thread_block(enum task_status stat) {
     intr_set_status(old_status);
 }
 
+/**
+ * wakeup - 把被阻塞的线程 pthread 交给它的调度类放回就绪队列
+ * @pthread: 被阻塞的线程
+ * @reason: ENQUEUE_WAKEUP 或 ENQUEUE_WAKEUP_IO
+ *
+ * 被唤醒的线程所属调度类的 rank 更小，或同一调度类认为它应当抢占时，请求重新调度，
+ * 使被唤醒的线程最迟在下一个时钟中断时就能运行。实时线程不等时钟中断，在这里立即切换过去，
+ * 唤醒延迟因此与时钟频率无关。调用者在返回后才继续执行，必须已经处于可以被抢占的一致状态。
+ */
+static void wakeup(struct task_struct *pthread, enum enqueue_reason reason) {
+    enum intr_status old_status = intr_disable();
+
+    ASSERT(pthread->status == TASK_BLOCKED || pthread->status == TASK_HANGING ||
+            pthread->status == TASK_WAITING);
+
+    pthread->status = TASK_READY;
+    pthread->wakeup_tsc = rdtsc();
+    pthread->sched_class->enqueue(pthread, reason);
+    struct task_struct *cur_thread = running_thread();
+    if (pthread->sched_class->rank < cur_thread->sched_class->rank ||
+        (pthread->sched_class == cur_thread->sched_class &&
+         pthread->sched_class->check_preempt(cur_thread, pthread))) {
+        need_resched = true;
+        if (pthread->sched_class == &rt_sched_class && cur_thread->status == TASK_RUNNING)
+            schedule();
+    }
+    intr_set_status(old_status);
+}
+
 /**
  * thread_unblock - 解除指定线程的阻塞状态
  * @pthread: 要解除阻塞的线程指针
@@ -183,26 +273,159 @@ void thread_block(enum task_status stat) {
  * 将给定的线程从阻塞状态移动到就绪状态，使其重新具备调度资格。
  */
 void thread_unblock(struct task_struct *pthread) {
+    wakeup(pthread, ENQUEUE_WAKEUP);
+}
+
+/**
+ * thread_unblock_io - 解除等待 I/O 的线程的阻塞状态
+ * @pthread: 要解除阻塞的线程指针
+ *
+ * 与 thread_unblock 相同，但调度类可以据此优待交互式任务，如多级反馈调度类会提升它的级别。
+ */
+void thread_unblock_io(struct task_struct *pthread) {
+    wakeup(pthread, ENQUEUE_WAKEUP_IO);
+}
+
+/**
+ * thread_yield - 主动让出 CPU
+ *
+ * 将当前线程交给它的调度类放回就绪队列并重新调度，线程状态为 TASK_READY，之后仍会被正常调度。
+ */
+void thread_yield(void) {
+    struct task_struct *cur_thread = running_thread();
     enum intr_status old_status = intr_disable();
+    cur_thread->status = TASK_READY;
+    cur_thread->sched_class->enqueue(cur_thread, ENQUEUE_YIELD);
+    schedule();
+    intr_set_status(old_status);
+}
 
-    ASSERT(pthread->status == TASK_BLOCKED || pthread->status == TASK_HANGING ||
-            pthread->status == TASK_WAITING);
-    
-    //if(pthread->status != TASK_READY){
-        //ASSERT(!list_elem_find(&thread_ready_list, &pthread->general_tag));
-        if (list_elem_find(&thread_ready_list, &pthread->general_tag))
-            PANIC("blocked thread in ready_list\n");
-        list_push(&thread_ready_list, &pthread->general_tag);
+/**
+ * thread_set_policy - 改变任务的调度策略
+ * @pthread: 任务
+ * @policy: 新的调度策略
+ * @rt_priority: 实时策略的优先级，其他策略忽略
+ *
+ * 就绪的任务从原调度类的就绪队列中取出，放入新调度类的就绪队列。正在运行的任务立即让出 CPU，
+ * 由新调度类重新选择；阻塞的任务在被唤醒时进入新调度类。
+ *
+ * 返回值: 成功返回 true；策略未知、实时优先级超出范围或 pthread 是空闲任务时返回 false。
+ */
+bool thread_set_policy(struct task_struct *pthread, enum sched_policy policy, uint8_t rt_priority) {
+    const struct sched_class *class;
+    switch (policy) {
+    case SCHED_MLFQ:
+        class = &mlfq_sched_class;
+        break;
+    case SCHED_FAIR:
+        class = &fair_sched_class;
+        break;
+    case SCHED_FIFO:
+    case SCHED_RR:
+        if (rt_priority < RT_PRIO_MIN || rt_priority > RT_PRIO_MAX)
+            return false;
+        class = &rt_sched_class;
+        break;
+    default:
+        return false;
+    }
+
+    if (pthread == idle_thread)
+        return false;
+
+    enum intr_status old_status = intr_disable();
+    /* 暂存在任务组中的任务不在就绪队列中，解除节流时再进入新调度类 */
+    bool queued = pthread->status == TASK_READY && !pthread->throttled;
+    if (queued)
+        pthread->sched_class->dequeue(pthread);
+    pthread->sched_class = class;
+    pthread->policy = policy;
+    pthread->rt_priority = class == &rt_sched_class ? rt_priority : 0;
+    if (queued) {
+        class->enqueue(pthread, ENQUEUE_NEW);
+        if (class == &rt_sched_class)
+            need_resched = true;
+    } else if (pthread->status == TASK_RUNNING) {
         pthread->status = TASK_READY;
-    //}
+        class->enqueue(pthread, ENQUEUE_NEW);
+        schedule();
+    }
     intr_set_status(old_status);
+    return true;
+}
+
+/* pid2task - 按 pid 查找任务，pid 为 0 时返回当前任务，找不到时返回 NULL */
+struct task_struct *pid2task(pid_t pid) {
+    if (pid == 0)
+        return running_thread();
+    enum intr_status old_status = intr_disable();
+    struct list_elem *elem = thread_all_list.head.next;
+    struct task_struct *pthread = NULL;
+    while (elem != &thread_all_list.tail) {
+        struct task_struct *task = elem2entry(struct task_struct, all_list_tag, elem);
+        if (task->pid == pid) {
+            pthread = task;
+            break;
+        }
+        elem = elem->next;
+    }
+    intr_set_status(old_status);
+    return pthread;
+}
+
+/**
+ * sys_sched_setscheduler - 改变任务 pid 的调度策略
+ * @pid: 任务的 pid，0 表示当前任务
+ * @policy: 新的调度策略
+ * @rt_priority: SCHED_FIFO/SCHED_RR 的优先级
+ *
+ * 返回值: 成功返回 0，任务不存在或参数无效时返回 -1。
+ */
+int32_t sys_sched_setscheduler(pid_t pid, enum sched_policy policy, uint8_t rt_priority) {
+    struct task_struct *pthread = pid2task(pid);
+    if (pthread == NULL || !thread_set_policy(pthread, policy, rt_priority))
+        return -1;
+    return 0;
+}
+
+/**
+ * sys_sched_latency - 获取任务 pid 从被唤醒到开始运行的延迟统计
+ * @pid: 任务的 pid，0 表示当前任务
+ * @lat: 用户提供的缓冲区
+ *
+ * 返回值: 成功返回 0，任务不存在时返回 -1。
+ */
+int32_t sys_sched_latency(pid_t pid, struct sched_latency *lat) {
+    struct task_struct *pthread = pid2task(pid);
+    if (pthread == NULL)
+        return -1;
+    *lat = pthread->latency;
+    return 0;
+}
+
+/**
+ * idle - 空闲任务，没有其他任务可以运行时被调度
+ *
+ * 关中断后阻塞自己，schedule 找不到其他任务时才会切换回来，此时仍处于关中断状态，中间不会漏掉唤醒。
+ * 然后把定时器改为单次模式并执行 hlt；sti 的下一条指令执行完才响应中断，hlt 之前到来的中断同样能唤醒它。
+ */
+static void idle(void *arg) {
+    while (1) {
+        intr_disable();
+        thread_block(TASK_BLOCKED);
+        timer_idle_enter();
+        asm volatile("sti; hlt" : : : "memory");
+    }
 }
 
 void thread_init() {
     put_str("  thread_init start\n");
-    list_init(&thread_ready_list);
+    uint32_t i;
+    for (i = 0; i < SCHED_CLASS_CNT; i++)
+        sched_classes[i]->init();
     list_init(&thread_all_list);
     lock_init(&pid_lock);
     make_main_thread();
+    idle_thread = thread_start("idle", 10, idle, NULL);
     put_str("  thread_init done\n");
 }
\ No newline at end of file
@@ -2,14 +2,20 @@
 #define __THREAD_THREAD_H
 #include "list.h"
 #include "memory.h"
+#include "sched.h"
+#include "task_group.h"
+#include "vma.h"
 #include "stdint.h"
 
 #define MAX_FILES_OPEN_PER_PROC 8
 #define TASK_NAME_LEN 16
+#define STACK_MAGIC 0x20030807
 
 typedef void thread_func(void *);
 typedef int16_t pid_t;
 
+extern bool need_resched;
+
 /* 线程生命周期内可能的状态 */
 enum task_status {
     TASK_RUNNING,
@@ -85,13 +91,30 @@ struct thread_stack {
  * @self_kstack: 各线程的内核栈顶指针。
  * @status: 线程状态。
  * @name: 任务（线程或进程）的名字。
- * @priority: 线程的优先级。
+ * @priority: 线程的优先级，决定时间片长度和在就绪队列中的初始级别。
  * @ticks: 每次在处理器是执行的时间嘀嗒数。
+ * @sched_class: 任务所属的调度类。
+ * @policy: 任务的调度策略，实时调度类据此区分 SCHED_FIFO 和 SCHED_RR。
+ * @rt_priority: 实时任务的优先级，RT_PRIO_MIN 到 RT_PRIO_MAX，数值越大越优先。
+ * @wakeup_tsc: 最近一次被唤醒时的时间戳计数器，开始运行后清零。
+ * @latency: 从被唤醒到开始运行的延迟统计。
+ * @group: 任务所在的任务组，为 NULL 时不受 CPU 配额限制。
+ * @throttled: 任务所在的组已用完配额，任务暂存在组中而不在就绪队列中。
+ * @sleep_until: 睡眠的线程被唤醒时的全局 ticks。
+ * @level: 多级反馈调度类中的级别，用完时间片降一级，阻塞后被唤醒时恢复，被 I/O 唤醒时还会提升。
+ * @fair_node: 公平调度类中就绪任务在红黑树中的节点。
+ * @vruntime: 公平调度类中的虚拟运行时间，按优先级加权。
+ * @fair_seen_ticks: 上次结算虚拟运行时间时的 elapsed_ticks。
+ * @fair_start_ticks: 本次被公平调度类选中时的 elapsed_ticks。
  * @elapsed_ticks: 此任务自上CPU后一共执行了多少嘀嗒数。
  * @general_tag: 线程在一般的队列中的节点
  * @all_list_tag: 线程在线程队列 thread_all_list 中的节点
  * @pg_dir: 描述自己页表的虚拟地址，如果是TCB，则为NULL
- * @userprog_vaddr: 用户进程的虚拟内存池
+ * @pg_dir_phy: 页目录的物理地址，内核线程为 KERNEL_PAGE_DIR_PHY，任务切换时直接装入 CR3
+ * @userprog_vmas: 用户进程已预留的虚拟内存区域
+ * @rss_pages: 用户进程已映射物理页框的虚拟页面数，4MB 大页按 1024 页计
+ * @u_block_desc: 用户进程的内存块描述符，用于进程自己的堆分配
+ * @page_mag: 任务私有的页框弹匣，下标 MAG_KERNEL/MAG_USER 分别缓存内核、用户内存池的页框
  * @stack_magic: 魔数，用与栈的边界标记。
  */
 struct task_struct {
@@ -102,13 +125,32 @@ struct task_struct {
     uint8_t priority;
     uint8_t ticks;
     uint32_t elapsed_ticks;
+    const struct sched_class *sched_class;
+    enum sched_policy policy;
+    uint8_t rt_priority;
+    uint64_t wakeup_tsc;
+    struct sched_latency latency;
+    struct task_group *group;
+    bool throttled;
+    uint32_t sleep_until;
+    uint8_t level;
+    struct rb_node fair_node;
+    uint64_t vruntime;
+    uint32_t fair_seen_ticks;
+    uint32_t fair_start_ticks;
     struct list_elem general_tag;
     struct list_elem all_list_tag;
     uint32_t *pg_dir; 
-    struct virtual_addr userprog_vaddr; //
+    uint32_t pg_dir_phy;
+    struct vma_tree userprog_vmas;
+    uint32_t rss_pages;
+    struct mem_block_desc u_block_desc[MB_DESC_CNT];
+    struct page_magazine page_mag[2];
     uint32_t stack_magic;
 };
 
+extern struct task_struct *idle_thread;
+
 void thread_init();
 struct task_struct *running_thread();
 void init_thread(struct task_struct *thread, char *name, int _priority);
@@ -117,4 +159,12 @@ struct task_struct *thread_start(char *name, int _priority,thread_func function,
 void schedule();
 void thread_block(enum task_status stat);
 void thread_unblock(struct task_struct *pthread);
+void thread_unblock_io(struct task_struct *pthread);
+void thread_ready_add(struct task_struct *pthread);
+bool thread_set_policy(struct task_struct *pthread, enum sched_policy policy, uint8_t rt_priority);
+struct task_struct *pid2task(pid_t pid);
+int32_t sys_sched_setscheduler(pid_t pid, enum sched_policy policy, uint8_t rt_priority);
+int32_t sys_sched_latency(pid_t pid, struct sched_latency *lat);
+void thread_yield(void);
+pid_t fork_pid(void);
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+# 把 mem_profile_dump 输出中的调用点地址翻译成 "函数名+偏移"。
+# 用法: awk -f tools/memprof_sym.awk build/kernel.map memprof.log
+# 第一个文件是 ld -Map 生成的链接映射，第二个文件是保存下来的 "memprof ..." 输出。
+
+function hex(s,    i, c, v) {
+    s = tolower(s)
+    sub(/^0x/, "", s)
+    v = 0
+    for (i = 1; i <= length(s); i++) {
+        c = index("0123456789abcdef", substr(s, i, 1))
+        if (c == 0)
+            return -1
+        v = v * 16 + c - 1
+    }
+    return v
+}
+
+# 链接映射中符号行的格式为 "<空白>0x地址<空白>符号名"
+FNR == NR {
+    if (NF == 2 && $1 ~ /^0x[0-9a-fA-F]+$/ && $2 ~ /^[A-Za-z_][A-Za-z0-9_]*$/) {
+        sym_addr[nsym] = hex($1)
+        sym_name[nsym] = $2
+        nsym++
+    }
+    next
+}
+
+$1 == "memprof" && NF == 5 && $2 ~ /^(0x)?[0-9A-Fa-f]+$/ {
+    addr = hex($2)
+    best = -1
+    for (i = 0; i < nsym; i++) {
+        if (sym_addr[i] <= addr && (best < 0 || sym_addr[i] > sym_addr[best]))
+            best = i
+    }
+    where = best < 0 ? "?" : sprintf("%s+0x%x", sym_name[best], addr - sym_addr[best])
+    printf "%-32s pages=%d allocs=%d last_tick=%d\n", where, hex($3), hex($4), hex($5)
+    next
+}
+
+$1 == "memprof" { print }
\ No newline at end of file
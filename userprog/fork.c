@@ -0,0 +1,104 @@
+#include "fork.h"
+#include "debug.h"
+#include "global.h"
+#include "interrupt.h"
+#include "list.h"
+#include "memory.h"
+#include "process.h"
+#include "shm.h"
+#include "string.h"
+#include "thread.h"
+#include "vma.h"
+
+extern void intr_exit(void);
+extern struct list thread_all_list;
+
+/**
+ * copy_pcb_vmas_stack0 - 把父进程的 PCB、内核栈和虚拟内存区域复制给子进程
+ * @child_thread: 子进程的 PCB
+ * @parent_thread: 父进程的 PCB
+ *
+ * 整页复制 PCB，内核栈顶部保存着父进程进入 fork 系统调用时的中断栈，子进程从这里返回用户态。
+ * 任务私有的状态随后重新初始化，区域树则逐个区域复制，两个进程的地址空间从此各自独立。
+ *
+ * 返回值: 成功返回 0，复制区域树时内存不足返回 -1。
+ */
+static int32_t copy_pcb_vmas_stack0(struct task_struct *child_thread, struct task_struct *parent_thread) {
+    memcpy(child_thread, parent_thread, PAGE_SIZE);
+    child_thread->pid = fork_pid();
+    child_thread->status = TASK_READY;
+    child_thread->ticks = child_thread->priority;
+    child_thread->elapsed_ticks = 0;
+    child_thread->wakeup_tsc = 0;
+    memset(&child_thread->latency, 0, sizeof(child_thread->latency));
+    child_thread->general_tag.prev = child_thread->general_tag.next = NULL;
+    child_thread->all_list_tag.prev = child_thread->all_list_tag.next = NULL;
+    /* 弹匣中的页框属于父进程，子进程从空弹匣开始 */
+    child_thread->page_mag[MAG_KERNEL].cnt = 0;
+    child_thread->page_mag[MAG_USER].cnt = 0;
+
+    if (!vma_tree_copy(&child_thread->userprog_vmas, &parent_thread->userprog_vmas))
+        return -1;
+    return 0;
+}
+
+/**
+ * build_child_stack - 为子进程构建 thread_stack，使它第一次被调度时直接从中断返回
+ * @child_thread: 子进程的 PCB
+ *
+ * 中断栈中的 eax 改为 0 作为子进程中 fork 的返回值。switch_to 依次弹出 ebp、ebx、edi、esi
+ * 后执行 ret，因此在中断栈之下留出这四个寄存器的位置，并把返回地址设为 intr_exit。
+ */
+static void build_child_stack(struct task_struct *child_thread) {
+    struct intr_stack *intr_0_stack =
+        (struct intr_stack *)((uint32_t)child_thread + PAGE_SIZE - sizeof(struct intr_stack));
+    intr_0_stack->eax = 0;
+
+    uint32_t *ret_addr_in_thread_stack = (uint32_t *)intr_0_stack - 1;
+    uint32_t *ebp_ptr_in_thread_stack = (uint32_t *)intr_0_stack - 5;
+    *ret_addr_in_thread_stack = (uint32_t)intr_exit;
+    child_thread->self_kstack = ebp_ptr_in_thread_stack;
+}
+
+/**
+ * sys_fork - 以写时复制的方式复制当前用户进程
+ *
+ * 子进程得到父进程 PCB、区域树和页目录的副本，用户页框则全部与父进程共享，
+ * 可写页面在两边都改为只读，由缺页异常在第一次写入时复制。
+ *
+ * 返回值: 父进程中返回子进程的 pid，子进程中返回 0，失败时返回 -1。
+ */
+pid_t sys_fork(void) {
+    struct task_struct *parent_thread = running_thread();
+    ASSERT(parent_thread->pg_dir != NULL);
+
+    struct task_struct *child_thread = get_kernel_pages(1);
+    if (child_thread == NULL)
+        return -1;
+    if (copy_pcb_vmas_stack0(child_thread, parent_thread) == -1) {
+        mfree_page(PF_KERNEL, child_thread, 1);
+        return -1;
+    }
+
+    child_thread->pg_dir = create_page_dir();
+    if (child_thread->pg_dir == NULL || !cow_share(child_thread->pg_dir)) {
+        if (child_thread->pg_dir != NULL)
+            mfree_page(PF_KERNEL, child_thread->pg_dir, 1);
+        vma_remove(&child_thread->userprog_vmas, USER_VADDR_START, 0xc0000000);
+        mfree_page(PF_KERNEL, child_thread, 1);
+        return -1;
+    }
+    shm_fork(child_thread);
+    child_thread->pg_dir_phy = addr_v2p((uint32_t)child_thread->pg_dir);
+    build_child_stack(child_thread);
+
+    /* 到这里 fork 不会再失败，子进程才计入父进程所在的任务组 */
+    task_group_fork(child_thread);
+    enum intr_status old_status = intr_disable();
+    thread_ready_add(child_thread);
+    ASSERT(!list_elem_find(&thread_all_list, &child_thread->all_list_tag));
+    list_append(&thread_all_list, &child_thread->all_list_tag);
+    intr_set_status(old_status);
+
+    return child_thread->pid;
+}
\ No newline at end of file
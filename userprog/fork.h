@@ -0,0 +1,6 @@
+#ifndef __USERPROG_FORK_H
+#define __USERPROG_FORK_H
+#include "thread.h"
+
+pid_t sys_fork(void);
+#endif
\ No newline at end of file
@@ -10,9 +10,9 @@
 #include "thread.h"
 #include "tss.h"
 #include "userprog.h"
+#include "vma.h"
 
 extern void intr_exit(void);
-extern struct list thread_ready_list;
 extern struct list thread_all_list;
 
 /**
@@ -46,9 +46,8 @@ void start_process(void *_filename) {
 
     proc_stack->ss = SELECTOR_U_DATA;
 
-    /* 为用户进程分配优先级为3的栈 */
-    proc_stack->esp =
-        (void *)((uint32_t)get_a_page(PF_USER, USER_STACK3_VADDR) + PAGE_SIZE);
+    /* 用户进程的特权级3栈不预先分配页面，首次压栈时由缺页中断按需分配，并随使用向下增长 */
+    proc_stack->esp = (void *)(USER_STACK3_VADDR + PAGE_SIZE);
 
     /* 跳转到中断退出，以便CPU通过中断从高权限级别（操作系统内核）完成到低权限级别（用户进程）的转换 */
     asm volatile("movl %0,%%esp; jmp intr_exit" ::"g"(proc_stack) : "memory");
@@ -60,16 +59,14 @@ void start_process(void *_filename) {
  *
  * 此函数将适当的页目录地址加载到CR3寄存器中。
  * 如果线程是用户进程，则使用其自己的页目录；否则，使用内核的页目录。
+ * 页目录的物理地址在创建任务时已缓存于 pg_dir_phy。下一个任务与当前使用同一个页目录时
+ * （例如内核线程之间切换）不重新加载 CR3，TLB 中的用户页面映射因此得以保留。
  */
 void page_dir_activate(struct task_struct *pthread) {
-    /* 内核线程 */
-    uint32_t page_dir_phy_addr = 0x100000;
-    /* 线程还是进程？ */
-    if (pthread->pg_dir != NULL) {
-        /* 进程，切换页目录（PD） */
-        page_dir_phy_addr = addr_v2p((uint32_t)pthread->pg_dir);
-    }
-    asm volatile("movl %0, %%cr3" ::"r"(page_dir_phy_addr) : "memory");
+    uint32_t cur_page_dir_phy_addr;
+    asm volatile("movl %%cr3, %0" : "=r"(cur_page_dir_phy_addr));
+    if (cur_page_dir_phy_addr != pthread->pg_dir_phy)
+        asm volatile("movl %0, %%cr3" ::"r"(pthread->pg_dir_phy) : "memory");
 }
 
 /**
@@ -101,9 +98,8 @@ uint32_t *create_page_dir(void) {
         return NULL;
     }
 
-    /* 通过将上部1GB（PDE.768~PDE.1023）映射到内核物理地址空间（页目录中的1024/4=256
-    * 条目，即1GB），在用户虚拟地址空间中创建内核入口 */
-    memcpy((uint32_t *)((uint32_t)user_page_dir_vaddr + 0x300 * 4), (uint32_t *)(0xfffff000 + 0x300 * 4), 1024);
+    /* 上部1GB（PDE.768~PDE.1022）与内核共享同一组预先建立的页表，在用户虚拟地址空间中创建内核入口 */
+    kernel_pde_copy(user_page_dir_vaddr);
 
     /* 让用户PDE的最后一项指向页目录本身 */
     uint32_t user_page_dir_phy_addr = addr_v2p((uint32_t)user_page_dir_vaddr);
@@ -112,19 +108,16 @@ uint32_t *create_page_dir(void) {
 }
 
 /**
- * create_user_vaddr_bitmap() - 创建用于管理用户进程虚拟地址的位图。
+ * create_user_vmas() - 初始化用户进程的虚拟内存区域树。
  * @user_prog: 指向用户进程任务结构的指针。
  *
- * 初始化用于管理用户进程虚拟地址的位图，从预定义的用户虚拟地址（0x8048000）开始。
+ * 地址空间从预定义的用户虚拟地址（0x8048000）开始，到内核空间为止。只有实际预留的区域才占用内存，
+ * 初始时只预留用户栈区域，缺页处理程序据此让栈按需向下增长。
  */
-void create_user_vaddr_bitmap(struct task_struct *user_prog) {
-    user_prog->userprog_vaddr.vaddr_start = USER_VADDR_START;
-
-    /* 用户位图所需的物理页面数量 */
-    uint32_t bitmap_pg_cnt = DIV_ROUND_UP((0xc0000000 - USER_VADDR_START) / PAGE_SIZE / 8, PAGE_SIZE);
-    user_prog->userprog_vaddr.vaddr_bitmap.bits = get_kernel_pages(bitmap_pg_cnt);
-    user_prog->userprog_vaddr.vaddr_bitmap.bmap_bytes_len = (0xc0000000 - USER_VADDR_START) / PAGE_SIZE / 8;
-    bitmap_init(&user_prog->userprog_vaddr.vaddr_bitmap);
+void create_user_vmas(struct task_struct *user_prog) {
+    vma_tree_init(&user_prog->userprog_vmas, USER_VADDR_START, 0xc0000000);
+    if (!vma_insert(&user_prog->userprog_vmas, USER_STACK_LIMIT, 0xc0000000, VMA_STACK))
+        PANIC("create_user_vmas: no memory for stack area");
 }
 
 /**
@@ -133,7 +126,7 @@ void create_user_vaddr_bitmap(struct task_struct *user_prog) {
  * @name: 进程的名称。
  *
  * 此函数创建一个新的用户进程，初始化其线程结构，并将其添加到就绪队列和所有线程列表中。
- * 它还为用户进程创建必要的结构，如用户地址空间位图和页目录。
+ * 它还为用户进程创建必要的结构，如用户地址空间的区域树和页目录。
  */
 void process_execute(void *filename, char *name) {
     /* 为用户进程创建PCB（本质上是一个线程）*/
@@ -141,19 +134,20 @@ void process_execute(void *filename, char *name) {
     ASSERT(user_thread != NULL);
     /* 初始化用户进程的PCB */
     init_thread(user_thread, name, default_prio);
-    /* 为虚拟地址空间创建位图 */
-    create_user_vaddr_bitmap(user_thread);
+    /* 为虚拟地址空间创建区域树 */
+    create_user_vmas(user_thread);
     /* 初始化线程栈 */
     thread_create(user_thread, start_process, filename);
     /* 创建用户进程的页目录以进行地址映射 */
     user_thread->pg_dir = create_page_dir();
+    ASSERT(user_thread->pg_dir != NULL);
+    user_thread->pg_dir_phy = addr_v2p((uint32_t)user_thread->pg_dir);
 
-    //block_desc_init(user_thread->u_mb_desc_arr);
+    block_desc_init(user_thread->u_block_desc);
 
     /* 准备运行 */
     enum intr_status old_status = intr_disable();
-    ASSERT(!list_elem_find(&thread_ready_list, &user_thread->general_tag));
-    list_append(&thread_ready_list, &user_thread->general_tag);
+    thread_ready_add(user_thread);
 
     ASSERT(!list_elem_find(&thread_all_list, &user_thread->all_list_tag));
     list_append(&thread_all_list, &user_thread->all_list_tag);
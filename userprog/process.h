@@ -2,7 +2,7 @@
 #define __USERPROG_PROCESS_H
 
 #include "thread.h"
-#define USER_VADDR_START 0x8048000
+#include "userprog.h"
 #define default_prio 31
 
 void process_execute(void *filename, char *name);
@@ -0,0 +1,197 @@
+#include "shm.h"
+#include "debug.h"
+#include "global.h"
+#include "memory.h"
+#include "print.h"
+#include "string.h"
+#include "sync.h"
+#include "thread.h"
+#include "vma.h"
+
+/**
+ * struct shm_segment - 匿名共享内存段
+ * @used: 该槽位是否已被占用
+ * @pg_cnt: 段的页面数
+ * @frames: 各页面对应的用户内存池页框的物理地址，存放在内核页面中
+ * @attach_cnt: 当前映射了该段的次数
+ *
+ * 段本身持有每个页框的一个引用，每次 attach 再为每个页框增加一个引用，
+ * 因此同一组页框可以同时映射到多个进程的页目录中，只要还有一处映射就不会被回收。
+ */
+struct shm_segment {
+    bool used;
+    uint32_t pg_cnt;
+    uint32_t *frames;
+    uint32_t attach_cnt;
+};
+
+static struct shm_segment segments[SHM_MAX_SEGMENTS];
+/* 保护 segments，创建、映射和解除映射互斥进行 */
+static struct lock shm_lock;
+
+/* frames_pages - 存放 pg_cnt 个页框地址所需的内核页面数 */
+static uint32_t frames_pages(uint32_t pg_cnt) {
+    return DIV_ROUND_UP(pg_cnt * sizeof(uint32_t), PAGE_SIZE);
+}
+
+/**
+ * shm_segment_release - 释放段持有的前 frame_cnt 个页框及页框地址数组
+ * @seg: 共享内存段
+ * @frame_cnt: 已分配的页框数
+ */
+static void shm_segment_release(struct shm_segment *seg, uint32_t frame_cnt) {
+    uint32_t i;
+    for (i = 0; i < frame_cnt; i++)
+        pfree(seg->frames[i]);
+    mfree_page(PF_KERNEL, seg->frames, frames_pages(seg->pg_cnt));
+    seg->used = false;
+}
+
+/* shm_init - 初始化共享内存段表 */
+void shm_init(void) {
+    put_str("  shm_init start\n");
+    lock_init(&shm_lock);
+    memset(segments, 0, sizeof(segments));
+    put_str("  shm_init done\n");
+}
+
+/**
+ * sys_shm_create - 创建一个至少 size 字节的共享内存段
+ * @size: 段的大小，向上取整到页
+ *
+ * 页框在创建时一次性从用户内存池分配并清零，之后各进程 attach 时只建立映射，数据不会经过内核复制。
+ * 段在最后一次 detach 时释放；从未被 attach 过的段会一直保留。
+ *
+ * 返回值: 段的编号，失败时返回 -1。
+ */
+int32_t sys_shm_create(uint32_t size) {
+    uint32_t pg_cnt = DIV_ROUND_UP(size, PAGE_SIZE);
+    if (pg_cnt == 0 || pg_cnt > SHM_MAX_PAGES)
+        return -1;
+
+    lock_acquire(&shm_lock);
+    int32_t id;
+    for (id = 0; id < SHM_MAX_SEGMENTS && segments[id].used; id++)
+        ;
+    if (id == SHM_MAX_SEGMENTS) {
+        lock_release(&shm_lock);
+        return -1;
+    }
+
+    struct shm_segment *seg = &segments[id];
+    seg->frames = get_kernel_pages(frames_pages(pg_cnt));
+    if (seg->frames == NULL) {
+        lock_release(&shm_lock);
+        return -1;
+    }
+    seg->pg_cnt = pg_cnt;
+    seg->attach_cnt = 0;
+
+    uint32_t i;
+    for (i = 0; i < pg_cnt; i++) {
+        bool zeroed;
+        void *page_phy_addr = palloc_zeroed(&user_pool, &zeroed);
+        if (page_phy_addr == NULL) {
+            shm_segment_release(seg, i);
+            lock_release(&shm_lock);
+            return -1;
+        }
+        /* 用户内存池的页框没有映射在内核空间，经由临时映射窗口清零 */
+        if (!zeroed) {
+            void *vaddr = kmap((uint32_t)page_phy_addr);
+            memset(vaddr, 0, PAGE_SIZE);
+            kunmap(vaddr);
+        }
+        seg->frames[i] = (uint32_t)page_phy_addr;
+    }
+    seg->used = true;
+    lock_release(&shm_lock);
+    return id;
+}
+
+/**
+ * sys_shm_attach - 把共享内存段映射到当前进程的地址空间
+ * @id: 段的编号
+ *
+ * 在进程的虚拟内存区域树中预留一段 VMA_SHM 区域，用 map_range 一次性映射段的全部页框。
+ * 页面标记为 PG_SHARED，fork 之后父子进程仍然共享可写。
+ *
+ * 返回值: 映射的起始虚拟地址，失败时返回 NULL。
+ */
+void *sys_shm_attach(int32_t id) {
+    struct task_struct *cur_thread = running_thread();
+    if (cur_thread->pg_dir == NULL || id < 0 || id >= SHM_MAX_SEGMENTS)
+        return NULL;
+
+    lock_acquire(&shm_lock);
+    struct shm_segment *seg = &segments[id];
+    uint32_t vaddr = 0;
+    if (seg->used)
+        vaddr = vma_alloc(&cur_thread->userprog_vmas, seg->pg_cnt, VMA_SHM);
+    if (vaddr == 0) {
+        lock_release(&shm_lock);
+        return NULL;
+    }
+    vma_find(&cur_thread->userprog_vmas, vaddr)->shm_id = id;
+    if (!map_range(vaddr, seg->frames, 0, seg->pg_cnt, PG_US_U | PG_RW_W | PG_SHARED)) {
+        vma_remove(&cur_thread->userprog_vmas, vaddr, vaddr + seg->pg_cnt * PAGE_SIZE);
+        lock_release(&shm_lock);
+        return NULL;
+    }
+
+    uint32_t i;
+    for (i = 0; i < seg->pg_cnt; i++)
+        frame_ref_get(seg->frames[i]);
+    seg->attach_cnt++;
+    lock_release(&shm_lock);
+    return (void *)vaddr;
+}
+
+/**
+ * sys_shm_detach - 解除 shm_attach 建立的映射
+ * @addr: shm_attach 返回的地址
+ *
+ * mfree_page 清除映射时每个页框只释放本次映射的引用。最后一次 detach 之后，段连同页框一起释放。
+ *
+ * 返回值: 成功返回 0，addr 不是共享内存映射的起始地址或映射与段不一致时返回 -1。
+ */
+int32_t sys_shm_detach(void *addr) {
+    struct task_struct *cur_thread = running_thread();
+    uint32_t vaddr = (uint32_t)addr;
+    if (cur_thread->pg_dir == NULL)
+        return -1;
+    struct vm_area *vma = vma_find(&cur_thread->userprog_vmas, vaddr);
+    if (vma == NULL || vma->start != vaddr || !(vma->flags & VMA_SHM) || vma->shm_id < 0)
+        return -1;
+
+    lock_acquire(&shm_lock);
+    struct shm_segment *seg = &segments[vma->shm_id];
+    if (!seg->used || seg->pg_cnt != (vma->end - vma->start) / PAGE_SIZE) {
+        lock_release(&shm_lock);
+        return -1;
+    }
+
+    mfree_page(PF_USER, addr, seg->pg_cnt);
+    if (--seg->attach_cnt == 0)
+        shm_segment_release(seg, seg->pg_cnt);
+    lock_release(&shm_lock);
+    return 0;
+}
+
+/**
+ * shm_fork - fork 出的子进程继承了父进程的共享内存映射，为每个映射增加段的 attach 计数
+ * @child: 子进程，区域树与页表都已复制完毕
+ *
+ * cow_share 已为继承的 PG_SHARED 页面增加了页框引用，这里补上段的计数，
+ * 父子进程各自 detach 一次之后段才会被释放。
+ */
+void shm_fork(struct task_struct *child) {
+    lock_acquire(&shm_lock);
+    struct rb_node *node;
+    for (node = rb_first(&child->userprog_vmas.root); node != NULL; node = rb_next(node)) {
+        struct vm_area *vma = elem2entry(struct vm_area, node, node);
+        if (vma->flags & VMA_SHM)
+            segments[vma->shm_id].attach_cnt++;
+    }
+    lock_release(&shm_lock);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef __USERPROG_SHM_H
+#define __USERPROG_SHM_H
+#include "stdint.h"
+
+struct task_struct;
+
+/* 共享内存段的最大个数 */
+#define SHM_MAX_SEGMENTS 16
+/* 单个共享内存段的最大页面数，即 16MB */
+#define SHM_MAX_PAGES 4096
+
+void shm_init(void);
+int32_t sys_shm_create(uint32_t size);
+void *sys_shm_attach(int32_t id);
+int32_t sys_shm_detach(void *addr);
+void shm_fork(struct task_struct *child);
+#endif
\ No newline at end of file
@@ -4,6 +4,11 @@
 #include "string.h"
 #include "syscall.h"
 #include "thread.h"
+#include "memory.h"
+#include "shm.h"
+#include "fork.h"
+#include "task_group.h"
+#include "timer.h"
 
 #define syscall_nr 32
 typedef void *syscall;
@@ -20,5 +25,18 @@ void syscall_init() {
     put_str("  syscall_init start\n");
     syscall_table[SYS_GETPID] = sys_getpid;
     syscall_table[SYS_WRITE] = sys_write;
+    syscall_table[SYS_MALLOC] = sys_malloc;
+    syscall_table[SYS_FREE] = sys_free;
+    syscall_table[SYS_MEMSTAT] = sys_memstat;
+    syscall_table[SYS_SHM_CREATE] = sys_shm_create;
+    syscall_table[SYS_SHM_ATTACH] = sys_shm_attach;
+    syscall_table[SYS_SHM_DETACH] = sys_shm_detach;
+    syscall_table[SYS_FORK] = sys_fork;
+    syscall_table[SYS_SCHED_SETSCHEDULER] = sys_sched_setscheduler;
+    syscall_table[SYS_SCHED_LATENCY] = sys_sched_latency;
+    syscall_table[SYS_TGROUP_CREATE] = sys_tgroup_create;
+    syscall_table[SYS_TGROUP_ATTACH] = sys_tgroup_attach;
+    syscall_table[SYS_TGROUP_DESTROY] = sys_tgroup_destroy;
+    syscall_table[SYS_SLEEP] = mtime_sleep;
     put_str("  syscall_init done\n");
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #ifndef __USERPROG_USERPROG_H
 #define __USERPROG_USERPROG_H
 
+#define USER_VADDR_START 0x8048000
 #define USER_STACK3_VADDR (0xc0000000 - 0x1000)
+/* 用户栈最多向下增长到此地址，即 8MB */
+#define USER_STACK_LIMIT (0xc0000000 - 0x800000)
 #endif
\ No newline at end of file